@@ -0,0 +1,369 @@
+#include "mvc_solver.hpp"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+#include <catch2/reporters/catch_reporter_streaming_base.hpp>
+
+#include <sstream>
+
+/*
+ * Micro-benchmarks of the stages of the cloning pipeline, timed separately:
+ *   boundary/<shape>/<length>[/<tol>]   getBoundary, exact and simplified to a tolerance in pixels
+ *   mesh/<shape>/<length>               AdaptiveMesh::createMesh
+ *   mesher/<backend>/<shape>/<length>   Mesher::mesh of every backend; vertex counts and membrane errors go to stderr
+ *   mvc/<length>                        MVCSolver::mvc for one interior point
+ *   coordinates/<length>                dense coordinates of all mesh vertices (MVCSolver::coordinates)
+ *   membrane/dense/<length>             weighted sum of boundary differences, dense coordinates
+ *   membrane/hierarchical/<megapixels>  weighted sum of boundary differences, hierarchical coordinates
+ *   membrane/compressed/<format>        weighted sum with compressed dense coordinates; sizes and error bounds go to stderr
+ *   interpolation/<megapixels>          rasterization of the membrane over the mask and final colours
+ *
+ * Masks are synthetic: circles, five-pointed stars and long thin bands with a given nominal boundary length in pixels,
+ * and, for the per-image stages, a disc covering about 40% of images from 0.5 to 50 megapixels.
+ *
+ * Run with `--reporter json --out bench.json` for machine-readable results; tags select stages, e.g. `[mesh]`.
+ */
+
+namespace
+{
+    enum class Shape { Circle, Star, Band };
+
+    std::string name(Shape shape)
+    {
+        switch (shape)
+        {
+            case Shape::Circle: return "circle";
+            case Shape::Star: return "star";
+            default: return "band";
+        }
+    }
+
+    std::vector<int> const lengths {500, 2000, 8000};
+    std::vector<double> const megapixels {0.5, 2.0, 8.0, 50.0};
+
+    /// <summary>
+    /// Three-channel mask of a shape whose outline is about `length` pixels long, centred on a canvas with a margin around it.
+    /// </summary>
+    cv::Mat makeMask(Shape shape, int length)
+    {
+        std::vector<cv::Point> polygon;
+        if (shape == Shape::Circle)
+        {
+            auto const r = length / (2.0 * CV_PI);
+            for (int i = 0; i < 720; ++i)
+                polygon.emplace_back(cvRound(r * std::cos(i * CV_PI / 360)), cvRound(r * std::sin(i * CV_PI / 360)));
+        }
+        else if (shape == Shape::Star)
+        {
+            // Ten edges between outer radius R and inner radius R / 2, 36 degrees apart.
+            auto const edge = std::sqrt(1.25 - std::cos(CV_PI / 5));
+            auto const r = length / (10.0 * edge);
+            for (int i = 0; i < 10; ++i)
+            {
+                auto const ri = i % 2 == 0 ? r : 0.5 * r;
+                polygon.emplace_back(cvRound(ri * std::sin(i * CV_PI / 5)), cvRound(-ri * std::cos(i * CV_PI / 5)));
+            }
+        }
+        else
+        {
+            // A band 8 pixels wide at 30 degrees.
+            auto const l = 0.5 * length - 8.0;
+            cv::Point2f corners[4];
+            cv::RotatedRect({0.0f, 0.0f}, {static_cast<float>(l), 8.0f}, 30.0f).points(corners);
+            for (auto const &c : corners)
+                polygon.emplace_back(cvRound(c.x), cvRound(c.y));
+        }
+
+        auto const box = cv::boundingRect(polygon);
+        for (auto &p : polygon)
+            p -= box.tl() - cv::Point(16, 16);
+        cv::Mat mask(box.height + 32, box.width + 32, CV_8UC3, cv::Scalar::all(0));
+        cv::fillPoly(mask, std::vector<std::vector<cv::Point>>{polygon}, cv::Scalar::all(255));
+        return mask;
+    }
+
+    /// <summary>
+    /// 4:3 image of about the given size, filled with a smooth gradient.
+    /// </summary>
+    cv::Mat makeImage(double megapixels)
+    {
+        auto const h = static_cast<int>(std::sqrt(megapixels * 1e6 * 3 / 4));
+        auto const w = h * 4 / 3;
+        cv::Mat img(h, w, CV_8UC3);
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                img.at<cv::Vec3b>(y, x) = cv::Vec3b(x * 255 / w, y * 255 / h, 128);
+        return img;
+    }
+
+    cv::Mat makeDisc(cv::Size size)
+    {
+        cv::Mat mask(size, CV_8UC3, cv::Scalar::all(0));
+        cv::circle(mask, {size.width / 2, size.height / 2}, static_cast<int>(0.36 * std::min(size.width, size.height)), cv::Scalar::all(255), cv::FILLED);
+        return mask;
+    }
+
+    /// <summary>
+    /// Boundary differences between two images, one row per colour channel, as gathered by the solver.
+    /// </summary>
+    CoordinateMatrix differences(Boundary const &boundary, cv::Mat const &src, cv::Mat const &dest)
+    {
+        CoordinateMatrix diff(3, boundary.size());
+        for (size_t i = 0; i < boundary.size(); ++i)
+        {
+            cv::Vec3d a {dest.at<cv::Vec3b>(boundary[i].y(), boundary[i].x())};
+            cv::Vec3d b {src.at<cv::Vec3b>(boundary[i].y(), boundary[i].x())};
+            for (int c = 0; c < 3; ++c)
+                diff.row(c)[i] = a[c] - b[c];
+        }
+        return diff;
+    }
+
+    std::string megapixelName(double mp)
+    {
+        std::ostringstream s;
+        s << mp << "MP";
+        return s.str();
+    }
+}
+
+TEST_CASE("Boundary extraction", "[boundary]")
+{
+    for (auto shape : {Shape::Circle, Shape::Star, Shape::Band})
+    {
+        for (auto length : lengths)
+        {
+            auto const mask = makeMask(shape, length);
+            BENCHMARK("boundary/" + name(shape) + "/" + std::to_string(length)) { return getBoundary(mask); };
+            BENCHMARK("boundary/" + name(shape) + "/" + std::to_string(length) + "/1px") { return getBoundary(mask, 1.0); };
+        }
+    }
+}
+
+TEST_CASE("Adaptive mesh", "[mesh]")
+{
+    for (auto shape : {Shape::Circle, Shape::Star, Shape::Band})
+    {
+        for (auto length : lengths)
+        {
+            auto const boundary = getBoundary(makeMask(shape, length));
+            BENCHMARK("mesh/" + name(shape) + "/" + std::to_string(length))
+            {
+                AdaptiveMesh mesh;
+                mesh.createMesh(boundary);
+                return mesh.triangles().size();
+            };
+        }
+    }
+}
+
+TEST_CASE("Mesher comparison", "[mesher]")
+{
+    // Boundary values that change by a few grey levels per pixel, and their exact membrane at a point.
+    auto const f = [](Point_2 const &p) { return 50.0 * std::sin(p.x() / 9.0) + 50.0 * std::cos(p.y() / 13.0); };
+    MVCSolver const solver;
+    auto const membrane = [&](Point_2 const &p, Boundary const &boundary)
+    {
+        auto const w = solver.mvc(p, boundary);
+        auto value = 0.0;
+        for (size_t i = 0; i < boundary.size(); ++i)
+            value += w[i] * f(boundary[i]);
+        return value;
+    };
+
+    for (auto backend : {MeshBackend::CGAL, MeshBackend::Quadtree})
+    {
+        auto const mesher = Mesher::create(backend);
+        auto const backendName = backend == MeshBackend::CGAL ? std::string("cgal") : std::string("quadtree");
+        for (auto shape : {Shape::Circle, Shape::Star, Shape::Band})
+        {
+            for (auto length : lengths)
+            {
+                auto const boundary = getBoundary(makeMask(shape, length));
+                auto const label = "mesher/" + backendName + "/" + name(shape) + "/" + std::to_string(length);
+                BENCHMARK(std::string(label))
+                {
+                    std::vector<Point_2> vertices;
+                    std::vector<std::array<int, 3>> triangles;
+                    mesher->mesh(boundary, vertices, triangles);
+                    return triangles.size();
+                };
+
+                std::vector<Point_2> vertices;
+                std::vector<std::array<int, 3>> triangles;
+                mesher->mesh(boundary, vertices, triangles);
+                std::cerr << label << ": " << vertices.size() << " vertices, " << triangles.size() << " triangles";
+
+                // Error of the interpolated membrane against the exact one at the centroids of up to 2000 triangles.
+                // Every vertex needs all boundary weights, so the longest outlines are skipped.
+                if (length <= 2000 && !triangles.empty())
+                {
+                    std::vector<double> values(vertices.size());
+                    #pragma omp parallel for schedule(dynamic, 64)
+                    for (int v = 0; v < static_cast<int>(vertices.size()); ++v)
+                        values[v] = membrane(vertices[v], boundary);
+
+                    auto const step = std::max<size_t>(1, triangles.size() / 2000);
+                    auto maxError = 0.0;
+                    for (size_t i = 0; i < triangles.size(); i += step)
+                    {
+                        auto const &t = triangles[i];
+                        Point_2 const centroid {(vertices[t[0]].x() + vertices[t[1]].x() + vertices[t[2]].x()) / 3.0, (vertices[t[0]].y() + vertices[t[1]].y() + vertices[t[2]].y()) / 3.0};
+                        auto const interpolated = (values[t[0]] + values[t[1]] + values[t[2]]) / 3.0;
+                        maxError = std::max(maxError, std::abs(interpolated - membrane(centroid, boundary)));
+                    }
+                    std::cerr << ", max membrane error " << maxError;
+                }
+                std::cerr << "\n";
+            }
+        }
+    }
+}
+
+TEST_CASE("Mean-value coordinates", "[mvc]")
+{
+    MVCSolver const solver;
+    for (auto length : lengths)
+    {
+        auto const mask = makeMask(Shape::Circle, length);
+        auto const boundary = getBoundary(mask);
+        Point_2 const centre {mask.cols / 2.0 + 0.25, mask.rows / 2.0 + 0.25};
+        BENCHMARK("mvc/" + std::to_string(length)) { return solver.mvc(centre, boundary); };
+
+        // All vertices at once; the coordinate matrix of the largest outline would not fit in memory.
+        if (length > 2000)
+            continue;
+        auto const plan = solver.meshing(boundary);
+        BENCHMARK_ADVANCED("coordinates/" + std::to_string(length))(Catch::Benchmark::Chronometer meter)
+        {
+            std::vector<MVCPlan> plans(meter.runs(), plan);
+            meter.measure([&](int i) { solver.coordinates(plans[i]); });
+        };
+    }
+}
+
+TEST_CASE("Weighted sum", "[membrane]")
+{
+    MVCSolver const solver;
+    for (auto length : {500, 2000})
+    {
+        auto const mask = makeMask(Shape::Circle, length);
+        auto const plan = solver.plans(mask).front();
+        auto const diff = differences(plan.boundary, cv::Mat(mask.size(), CV_8UC3, cv::Scalar(200, 150, 100)), cv::Mat(mask.size(), CV_8UC3, cv::Scalar(40, 80, 120)));
+        BENCHMARK("membrane/dense/" + std::to_string(length)) { return evaluateMembranes(plan, diff); };
+    }
+
+    {
+        auto const mask = makeMask(Shape::Circle, 2000);
+        auto const reference = solver.plans(mask).front();
+        auto const diff = differences(reference.boundary, cv::Mat(mask.size(), CV_8UC3, cv::Scalar(200, 150, 100)), cv::Mat(mask.size(), CV_8UC3, cv::Scalar(40, 80, 120)));
+        auto const exact = evaluateMembranes(reference, diff);
+        std::pair<char const *, WeightFormat> const formats[] = {{"float", WeightFormat::Float}, {"half", WeightFormat::Half},
+            {"bfloat16", WeightFormat::BFloat16}, {"int16", WeightFormat::Int16}, {"int8", WeightFormat::Int8}};
+        for (auto const &[label, format] : formats)
+        {
+            auto plan = reference;
+            plan.compressedCoordinates = CompressedCoordinates::compress(reference, {format, 0.0});
+            auto const membrane = evaluateMembranes(plan, diff);
+            auto error = 0.0;
+            for (size_t i = 0; i < membrane.size(); ++i)
+                error = std::max(error, std::abs(membrane[i] - exact[i]));
+            std::cerr << "membrane/compressed/" << label << ": " << plan.compressedCoordinates.bytes() / 1024 << " KB of "
+                      << reference.coordinates.rows() * reference.coordinates.stride() * sizeof(double) / 1024 << " KB, max error " << error
+                      << " (bound " << plan.compressedCoordinates.maxError() * 160.0 << ")\n";
+            BENCHMARK("membrane/compressed/" + std::string(label)) { return evaluateMembranes(plan, diff); };
+        }
+    }
+
+    MVCSolver hierarchical;
+    hierarchical.setSampling({Sampling::Hierarchical, 0.5});
+    for (auto mp : megapixels)
+    {
+        auto const src = makeImage(mp);
+        auto const plan = hierarchical.plans(makeDisc(src.size())).front();
+        auto const diff = differences(plan.boundary, src, cv::Mat(src.size(), CV_8UC3, cv::Scalar(40, 80, 120)));
+        BENCHMARK("membrane/hierarchical/" + megapixelName(mp)) { return evaluateMembranes(plan, diff); };
+    }
+}
+
+TEST_CASE("Interpolation", "[interpolation]")
+{
+    MVCSolver hierarchical;
+    hierarchical.setSampling({Sampling::Hierarchical, 0.5});
+    for (auto mp : megapixels)
+    {
+        auto const src = makeImage(mp);
+        auto const mask = makeDisc(src.size());
+        auto const plan = hierarchical.plans(mask).front();
+        auto const membrane = evaluateMembranes(plan, differences(plan.boundary, src, cv::Mat(src.size(), CV_8UC3, cv::Scalar(40, 80, 120))));
+
+        std::vector<RasterTriangle<cv::Vec3d>> triangles;
+        for (auto const &t : plan.triangles)
+        {
+            auto const value = [&](int v) { return cv::Vec3d(membrane[3 * v], membrane[3 * v + 1], membrane[3 * v + 2]); };
+            triangles.push_back({{plan.vertices[t[0]], plan.vertices[t[1]], plan.vertices[t[2]]}, {value(t[0]), value(t[1]), value(t[2])}});
+        }
+        auto const region = SpanMask(mask);
+        cv::Mat result = src.clone();
+
+        BENCHMARK("interpolation/" + megapixelName(mp))
+        {
+            rasterize(triangles, region, [&](int x, int y, cv::Vec3d const &c)
+            {
+                cv::Vec3d resultI = cv::Vec3d(src.at<cv::Vec3b>(y, x)) + c;
+                result.at<cv::Vec3b>(y, x) = {cv::saturate_cast<uchar>(resultI[0]), cv::saturate_cast<uchar>(resultI[1]), cv::saturate_cast<uchar>(resultI[2])};
+            });
+            return result.data;
+        };
+    }
+}
+
+/// <summary>
+/// Catch2 reporter that writes every benchmark result as one element of a JSON array, with times in nanoseconds.
+/// </summary>
+class JsonReporter : public Catch::StreamingReporterBase
+{
+    bool m_first = true;
+
+    public:
+        JsonReporter(Catch::ReporterConfig const &config) : StreamingReporterBase(config)
+        {
+            // Keep prints of the code under test out of the JSON document.
+            m_preferences.shouldRedirectStdOut = true;
+        }
+
+        static std::string getDescription() { return "Reports benchmark results as JSON"; }
+
+        void testRunStarting(Catch::TestRunInfo const &info) override
+        {
+            StreamingReporterBase::testRunStarting(info);
+            m_stream << "{\n  \"benchmarks\": [";
+        }
+
+        void benchmarkEnded(Catch::BenchmarkStats<> const &stats) override
+        {
+            m_stream << (m_first ? "\n" : ",\n") << "    {\"name\": \"" << stats.info.name << "\", "
+                     << "\"samples\": " << stats.info.samples << ", \"iterations\": " << stats.info.iterations << ", "
+                     << "\"mean_ns\": " << stats.mean.point.count() << ", "
+                     << "\"mean_low_ns\": " << stats.mean.lower_bound.count() << ", "
+                     << "\"mean_high_ns\": " << stats.mean.upper_bound.count() << ", "
+                     << "\"stddev_ns\": " << stats.standardDeviation.point.count() << ", "
+                     << "\"outlier_variance\": " << stats.outlierVariance << "}";
+            m_first = false;
+        }
+
+        void benchmarkFailed(Catch::StringRef name) override
+        {
+            m_stream << (m_first ? "\n" : ",\n") << "    {\"name\": \"" << name << "\", \"failed\": true}";
+            m_first = false;
+        }
+
+        void testRunEnded(Catch::TestRunStats const &stats) override
+        {
+            m_stream << "\n  ],\n  \"threads\": " << std::thread::hardware_concurrency() << "\n}\n";
+            StreamingReporterBase::testRunEnded(stats);
+        }
+};
+
+CATCH_REGISTER_REPORTER("json", JsonReporter)
@@ -1,7 +1,8 @@
 #ifndef DAPTIVEMESH_H_
 #define DAPTIVEMESH_H_
 
-#include "helpers.hpp"
+#include "geometry.hpp"
+#include "trace.hpp"
 
 static const std::filesystem::path dataDirPath { DATA_DIR };
 static const std::filesystem::path outDirPath { OUTPUT_DIR };
@@ -13,11 +14,15 @@ class AdaptiveMesh
     public:
         AdaptiveMesh() = default;
         
-        void createMesh(std::vector<Point_2> const &v);
-        std::vector<Point_2> getFace(Point_2 const &v);
-        std::vector<Point_2> vertices();
+        void createMesh(Boundary const &boundary);
+        void updateMesh(Boundary const &boundary, cv::Rect const &dirty);
+        std::array<Point_2, 3> getFace(Point_2 const &v) const;
+        std::vector<Point_2> const &vertices() const;
+        std::vector<std::array<int, 3>> triangles();
         void save(cv::Mat const &img, int const &i);
-    
+
+    private:
+        void refine(Boundary const &boundary);
 };
 
 #endif
\ No newline at end of file
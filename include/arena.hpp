@@ -0,0 +1,35 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+/// <summary>
+/// Monotonic arena for the temporaries of one solve. The buffer is allocated once, sized by the caller for the largest
+/// job; containers built on resource() then take their memory from it by bumping a pointer, and reset() makes the whole
+/// buffer available again for the next job. Requests beyond the buffer fall back to the heap until the next reset.
+/// Not thread-safe: every solve owns its arena.
+/// </summary>
+class SolveArena
+{
+    std::unique_ptr<std::byte[]> m_buffer;
+    std::pmr::monotonic_buffer_resource m_resource;
+
+    public:
+        explicit SolveArena(size_t bytes)
+            : m_buffer(new std::byte[std::max<size_t>(bytes, 1)]), m_resource(m_buffer.get(), std::max<size_t>(bytes, 1))
+        {
+        }
+
+        SolveArena(SolveArena const &) = delete;
+        SolveArena &operator=(SolveArena const &) = delete;
+
+        std::pmr::memory_resource *resource() { return &m_resource; }
+
+        // Everything allocated from the arena must be destroyed before.
+        void reset() { m_resource.release(); }
+};
+
+#endif
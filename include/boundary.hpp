@@ -0,0 +1,22 @@
+#ifndef BOUNDARY_H_
+#define BOUNDARY_H_
+
+#include "geometry.hpp"
+
+/*
+ * Boundary extraction from masks.
+ *
+ * Contours are traced only inside the bounding box of the mask, on the mask itself when it is already an 8-bit
+ * single-channel image. Rings are then optionally simplified with Douglas-Peucker: with a tolerance t, every boundary
+ * pixel that is dropped lies within t pixels of the simplified ring, so the mesh, the coordinate matrix and the
+ * membrane product shrink with the number of kept points while the patch moves by at most t. Masked pixels that fall
+ * outside the simplified rings keep the target. Where simplifying would make rings cross or move a hole out of its
+ * component, that component is simplified again with half the tolerance, down to its traced contours.
+ */
+
+cv::Mat maskPlane(cv::Mat const &mask);
+std::vector<Point_2> simplifyRing(std::vector<cv::Point> const &contour, double tolerance);
+std::vector<Boundary> getBoundaries(cv::Mat const &mask, double tolerance = 0.0);
+Boundary getBoundary(cv::Mat const &mask, double tolerance = 0.0);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef BOUNDEDQUEUE_H_
+#define BOUNDEDQUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/// <summary>
+/// Blocking FIFO queue of bounded capacity that connects two pipeline stages. A full queue blocks the producer, which
+/// keeps a fast stage from running ahead of a slow one and bounds the memory held by frames in flight.
+/// The producer calls close() after its last item; the consumer then drains the queue and pop() returns nothing.
+/// </summary>
+template <typename T>
+class BoundedQueue
+{
+    std::deque<T> m_items;
+    size_t m_capacity;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull, m_notEmpty;
+
+    public:
+        explicit BoundedQueue(size_t capacity) : m_capacity(capacity) {}
+
+        /// <summary>
+        /// Waits for free space and appends an item. Items pushed after close() are dropped.
+        /// </summary>
+        void push(T item)
+        {
+            std::unique_lock lock(m_mutex);
+            m_notFull.wait(lock, [&]{ return m_closed || m_items.size() < m_capacity; });
+            if (m_closed)
+                return;
+            m_items.push_back(std::move(item));
+            m_notEmpty.notify_one();
+        }
+
+        /// <summary>
+        /// Waits for an item and removes it from the queue.
+        /// </summary>
+        /// <returns>The oldest item, or nothing once the queue is closed and empty.</returns>
+        std::optional<T> pop()
+        {
+            std::unique_lock lock(m_mutex);
+            m_notEmpty.wait(lock, [&]{ return m_closed || !m_items.empty(); });
+            if (m_items.empty())
+                return std::nullopt;
+            auto item = std::move(m_items.front());
+            m_items.pop_front();
+            m_notFull.notify_one();
+            return item;
+        }
+
+        void close()
+        {
+            std::lock_guard lock(m_mutex);
+            m_closed = true;
+            m_notFull.notify_all();
+            m_notEmpty.notify_all();
+        }
+};
+
+#endif
@@ -20,7 +20,26 @@ static inline double getAngle(glm::vec2 a, glm::vec2 b)
 	return atan2(det, dotProd);
 }
 
-static inline std::vector<double> getBarycenterCoordinates(std::vector<Point_2> const &t, Point_2 p)
+static inline double getAngle(glm::dvec2 a, glm::dvec2 b)
+{
+	auto dotProd = glm::dot(a, b);
+	auto det = a.x*b.y - a.y*b.x;
+
+	return atan2(det, dotProd);
+}
+
+/// <summary>
+/// Tangent of half the signed angle from a to b, from the cross and dot products: sin(t) / (1 + cos(t)).
+/// </summary>
+static inline double halfAngleTan(glm::dvec2 a, glm::dvec2 b)
+{
+	auto dotProd = glm::dot(a, b);
+	auto det = a.x*b.y - a.y*b.x;
+
+	return det / (glm::length(a)*glm::length(b) + dotProd);
+}
+
+static inline std::array<double, 3> getBarycenterCoordinates(std::array<Point_2, 3> const &t, Point_2 p)
 {
 	auto v1 = t[0];
 	auto v2 = t[1];
@@ -31,27 +50,90 @@ static inline std::vector<double> getBarycenterCoordinates(std::vector<Point_2>
 	auto W2 = ((v3.y() - v1.y())*(p.x() - v3.x()) + (v1.x()-v3.x())*(p.y()-v3.y()))/total;
 	auto W3 = 1 - W1 - W2;
 
-	return std::vector<double>{W1, W2, W3};
+	return {W1, W2, W3};
 }
 
-static inline std::vector<Point_2> getBoundary(cv::Mat const &src)
+/// <summary>
+/// Boundary of one connected component of a mask: its outer contour followed by the contours of its holes, stored as a
+/// single list of points so that mean-value coordinates can index every boundary point. Ring r holds the points
+/// [rings[r], rings[r + 1]); every ring is closed, its last point connects back to its first.
+/// Holes run opposite to the outer contour, so that the component lies on the same side of every boundary edge.
+/// </summary>
+struct Boundary
 {
-	cv::Mat aux = src.clone();
-	cv::cvtColor(src, aux, cv::COLOR_BGRA2GRAY);
+	std::vector<Point_2> points;
+	std::vector<int> rings {0};
+
+	Boundary() = default;
+	Boundary(std::vector<Point_2> const &outer) { addRing(outer); }
+
+	size_t size() const { return points.size(); }
+	bool empty() const { return points.empty(); }
+	Point_2 const &operator[](size_t i) const { return points[i]; }
+	auto begin() const { return points.begin(); }
+	auto end() const { return points.end(); }
 
-	// Compute patch boundaries
-	std::vector<std::vector<cv::Point> > contours;
-	cv::Mat contourSrcPatch = aux.clone();
-	cv::findContours(contourSrcPatch, contours, cv::RETR_LIST, cv::CHAIN_APPROX_NONE);
+	int ringCount() const { return static_cast<int>(rings.size()) - 1; }
+	int ringOf(int i) const { return static_cast<int>(std::upper_bound(rings.begin(), rings.end(), i) - rings.begin()) - 1; }
+	int next(int i) const { auto const r = ringOf(i); return i + 1 == rings[r + 1] ? rings[r] : i + 1; }
+	int prev(int i) const { auto const r = ringOf(i); return i == rings[r] ? rings[r + 1] - 1 : i - 1; }
 
-	std::vector<Point_2> boundary;
+	void addRing(std::vector<Point_2> const &ring)
+	{
+		points.insert(points.end(), ring.begin(), ring.end());
+		rings.push_back(static_cast<int>(points.size()));
+	}
 
-	std::for_each(contours[0].begin(), contours[0].end(), [&boundary](auto p){boundary.push_back(Point_2{p.x, p.y});});
+	bool operator==(Boundary const &other) const { return points == other.points && rings == other.rings; }
+};
 
-	std::reverse(boundary.begin(),boundary.end()); 
+static inline double signedArea(std::vector<Point_2> const &ring)
+{
+	auto area = 0.0;
+	for (size_t i = 0; i < ring.size(); ++i)
+	{
+		auto const &a = ring[i];
+		auto const &b = ring[(i + 1) % ring.size()];
+		area += a.x() * b.y() - b.x() * a.y();
+	}
+	return 0.5 * area;
+}
 
-	return boundary;
+/// <summary>
+/// Arc length along the rings up to every point. The step after the last point of a ring is its closing edge,
+/// so arc[rings[r + 1]] - arc[rings[r]] is the perimeter of ring r.
+/// </summary>
+static inline std::vector<double> arcLengths(Boundary const &boundary)
+{
+	std::vector<double> arc(boundary.size() + 1, 0.0);
+	for (size_t i = 0; i < boundary.size(); ++i)
+	{
+		auto const &a = boundary[i];
+		auto const &b = boundary[boundary.next(static_cast<int>(i))];
+		arc[i + 1] = arc[i] + std::hypot(b.x() - a.x(), b.y() - a.y());
+	}
+	return arc;
+}
 
+/// <summary>
+/// A point strictly inside a simple polygon with integer vertices: the middle of the first inside span of a scanline
+/// halfway between pixel rows, which never passes through a vertex.
+/// </summary>
+static inline Point_2 interiorPoint(std::vector<Point_2> const &ring)
+{
+	auto const [lo, hi] = std::minmax_element(ring.begin(), ring.end(), [](auto const &a, auto const &b){ return a.y() < b.y(); });
+	auto const y = std::floor(0.5 * (lo->y() + hi->y())) + 0.5;
+
+	std::vector<double> xs;
+	for (size_t i = 0; i < ring.size(); ++i)
+	{
+		auto const &a = ring[i];
+		auto const &b = ring[(i + 1) % ring.size()];
+		if ((a.y() < y) != (b.y() < y))
+			xs.push_back(a.x() + (y - a.y()) * (b.x() - a.x()) / (b.y() - a.y()));
+	}
+	std::sort(xs.begin(), xs.end());
+	return Point_2{0.5 * (xs[0] + xs[1]), y};
 }
 
 #endif
\ No newline at end of file
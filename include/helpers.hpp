@@ -33,9 +33,8 @@ DISABLE_WARNINGS_POP()
 #include <vector>
 #include <thread>
 
+#include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
-#include <opencv2/highgui.hpp>
-#include <opencv2/opencv.hpp>
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/convex_hull_2.h>
@@ -48,11 +47,13 @@ DISABLE_WARNINGS_POP()
 #include <CGAL/Delaunay_triangulation_2.h>
 #include <CGAL/Triangulation_conformer_2.h>
 #include <CGAL/Delaunay_triangulation_adaptation_traits_2.h>
+#include <CGAL/Triangulation_vertex_base_with_info_2.h>
 typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
 typedef K::Point_2 Point_2;
 typedef CGAL::Polygon_2<K> Polygon_2;
 
-typedef CGAL::Triangulation_vertex_base_2<K> Vb;
+// Every mesh vertex carries its index in the vertex list of the mesh.
+typedef CGAL::Triangulation_vertex_base_with_info_2<int, K> Vb;
 typedef CGAL::Delaunay_mesh_face_base_2<K> Fb;
 typedef CGAL::Triangulation_data_structure_2<Vb, Fb> Tds;
 typedef CGAL::Delaunay_triangulation_2<K,Tds> DT2;
@@ -0,0 +1,57 @@
+#ifndef IMAGEIO_H_
+#define IMAGEIO_H_
+
+#include "bounded_queue.hpp"
+#include "helpers.hpp"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
+
+#include <opencv2/imgcodecs.hpp>
+
+/// <summary>
+/// How results are encoded: the file format, chosen by extension, and the compression settings of PNG and JPEG.
+/// </summary>
+struct ImageWriteOptions
+{
+    // Extension without the dot (e.g. "png", "jpg", "tiff") replacing the one of every output path; empty keeps them.
+    std::string format;
+    // zlib level from 0 (fastest, largest) to 9 (slowest, smallest).
+    int pngCompression = 1;
+    // From 0 to 100.
+    int jpegQuality = 95;
+
+    std::filesystem::path path(std::filesystem::path const &path) const;
+    std::vector<int> params() const;
+};
+
+cv::Mat readImage(std::string const &path, int flags = cv::IMREAD_COLOR);
+bool writeImage(std::string const &path, cv::Mat const &image, ImageWriteOptions const &options = {});
+
+/// <summary>
+/// Background image I/O for batches of jobs: reads run on a pool of reader threads and writes on a pool of encoder
+/// threads, so that the inputs of the next jobs are decoded and the outputs of the previous ones encoded while the
+/// current job is solved. Requests are served in order through bounded queues, which bound the number of images in
+/// flight: read() and write() block while their queue is full.
+/// </summary>
+class ImageIO
+{
+    ImageWriteOptions m_options;
+    BoundedQueue<std::function<void()>> m_reads, m_writes;
+    std::vector<std::thread> m_readers, m_writers;
+    std::atomic<size_t> m_failed {0};
+
+    public:
+        ImageIO(ImageWriteOptions const &options, int threads = 2, size_t queueDepth = 8);
+        ImageIO(ImageIO const &) = delete;
+        ImageIO &operator=(ImageIO const &) = delete;
+        ~ImageIO();
+
+        std::shared_future<cv::Mat> read(std::string const &path, int flags = cv::IMREAD_COLOR);
+        void write(std::string const &path, cv::Mat image);
+        size_t finish();
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef JOBSERVER_H_
+#define JOBSERVER_H_
+
+#include "bounded_queue.hpp"
+#include "lru_cache.hpp"
+#include "mvc_solver.hpp"
+
+#include <map>
+
+/*
+ * Long-lived batch server. Jobs arrive as JSON lines, one object per line:
+ *   {"id": "42", "src": "a.jpg", "mask": "a.png", "trgt": "b.jpg", "offset": [100, 20], "out": "b_42.png"}
+ * and every job is answered by one JSON line, in completion order:
+ *   {"id": "42", "status": "ok", "out": "<path written>", "ms": 3.1}
+ *   {"id": "42", "status": "error", "message": "..."}
+ * Relative output paths are resolved in the results folder.
+ *
+ * Decoded images (keyed by path and modification time) and the plans of every mask are kept in LRU caches that share a
+ * memory budget, so repeated jobs skip decoding, meshing and coordinate computation.
+ */
+
+struct ServerOptions
+{
+    int workers = 2;
+    size_t memoryBudget = size_t(1) << 30;
+};
+
+class JobServer
+{
+    MVCSolver const &m_solver;
+    ServerOptions m_options;
+    LruCache<std::string, cv::Mat> m_images;
+    LruCache<std::string, std::vector<MVCPlan>> m_plans;
+    std::mutex m_output;
+
+    public:
+        JobServer(MVCSolver const &solver, ServerOptions const &options);
+
+        void serve(std::istream &in, std::ostream &out);
+        std::string run(std::string const &line);
+
+    private:
+        std::shared_ptr<cv::Mat const> image(std::string const &path);
+        std::shared_ptr<std::vector<MVCPlan> const> plans(std::string const &maskPath, cv::Mat const &mask);
+};
+
+std::map<std::string, std::string> parseJsonObject(std::string const &line);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef LIVEPREVIEW_H_
+#define LIVEPREVIEW_H_
+
+#include "mvc_solver.hpp"
+
+/// <summary>
+/// Work done by one preview update.
+/// </summary>
+struct PreviewStats
+{
+    double ms = 0.0;
+    // Mesh vertices whose coordinates were carried over from the previous update, and vertices computed again.
+    size_t reused = 0;
+    size_t recomputed = 0;
+};
+
+/// <summary>
+/// Keeps the clone of a mask that is being edited up to date. After every edit only the mesh around the change is
+/// re-triangulated, and the mean-value coordinates of a vertex are only computed again if the edit can change them by
+/// more than a tolerance; everything else is carried over from the previous update.
+/// Coordinates are sampled hierarchically, so that even recomputing a large patch stays within an interactive frame.
+/// </summary>
+class LivePreview
+{
+    MVCSolver const &m_solver;
+    cv::Mat m_src, m_dest;
+    glm::vec2 m_offset;
+    SamplingOptions m_sampling;
+    double m_tolerance;
+
+    // One mesh and plan per mask component.
+    std::vector<std::unique_ptr<AdaptiveMesh>> m_meshes;
+    std::vector<MVCPlan> m_plans;
+    cv::Mat m_result;
+
+    public:
+        LivePreview(MVCSolver const &solver, cv::Mat const &src, cv::Mat const &dest, glm::vec2 const &offset, double tolerance = 1e-3, double epsilon = 0.5);
+
+        PreviewStats update(cv::Mat const &mask, cv::Rect const &dirty);
+        void reset();
+        cv::Mat const &result() const { return m_result; }
+};
+
+/// <summary>
+/// Keeps the clone of a fixed mask up to date while the patch is moved over the target. The mesh and coordinates are
+/// computed once; a move restores the target under the previous placement and renders the patch at the new one, so only
+/// the pixels of the two placements are touched.
+/// </summary>
+class PlacementPreview
+{
+    MVCSolver const &m_solver;
+    cv::Mat m_src, m_dest;
+    SpanMask m_region;
+    std::vector<MVCPlan> m_plans;
+    // Offsets that keep the whole mask inside the target.
+    cv::Point m_min, m_max;
+
+    cv::Mat m_frame;
+    cv::Point m_offset;
+    cv::Rect m_placed;
+
+    public:
+        PlacementPreview(MVCSolver const &solver, cv::Mat const &src, cv::Mat const &mask, cv::Mat const &dest, cv::Point const &offset);
+
+        std::vector<cv::Rect> moveTo(cv::Point const &offset);
+        cv::Point offset() const { return m_offset; }
+        cv::Mat const &frame() const { return m_frame; }
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef LRUCACHE_H_
+#define LRUCACHE_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/// <summary>
+/// Thread-safe least-recently-used cache bounded by the total size of its values in bytes.
+/// Values are handed out as shared pointers, so an evicted value stays valid for as long as a caller still holds it.
+/// </summary>
+template <typename Key, typename Value>
+class LruCache
+{
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<Value const> value;
+        size_t bytes;
+    };
+
+    size_t m_budget;
+    size_t m_bytes = 0;
+    size_t m_hits = 0, m_misses = 0;
+    std::list<Entry> m_entries;
+    std::unordered_map<Key, typename std::list<Entry>::iterator> m_index;
+    std::mutex m_mutex;
+
+    public:
+        explicit LruCache(size_t budget) : m_budget(budget) {}
+
+        /// <summary>
+        /// Looks up a value and marks it as most recently used.
+        /// </summary>
+        /// <returns>The value, or nullptr if it is not cached.</returns>
+        std::shared_ptr<Value const> get(Key const &key)
+        {
+            std::lock_guard lock(m_mutex);
+            auto const it = m_index.find(key);
+            if (it == m_index.end())
+            {
+                ++m_misses;
+                return nullptr;
+            }
+            ++m_hits;
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return it->second->value;
+        }
+
+        /// <summary>
+        /// Inserts (or replaces) a value and evicts the least recently used values until the cache fits its budget again.
+        /// A value larger than the whole budget is not cached.
+        /// </summary>
+        void put(Key const &key, std::shared_ptr<Value const> value, size_t bytes)
+        {
+            std::lock_guard lock(m_mutex);
+            if (auto const it = m_index.find(key); it != m_index.end())
+            {
+                m_bytes -= it->second->bytes;
+                m_entries.erase(it->second);
+                m_index.erase(it);
+            }
+            if (bytes > m_budget)
+                return;
+
+            m_entries.push_front({key, std::move(value), bytes});
+            m_index[key] = m_entries.begin();
+            m_bytes += bytes;
+            while (m_bytes > m_budget)
+            {
+                auto const &last = m_entries.back();
+                m_bytes -= last.bytes;
+                m_index.erase(last.key);
+                m_entries.pop_back();
+            }
+        }
+
+        /// <summary>
+        /// Returns the cached value, or computes it with load() and caches it. The lock is not held while loading, so
+        /// two threads that miss the same key at the same time both load it.
+        /// </summary>
+        /// <param name="load">Produces the value.</param>
+        /// <param name="size">Size of a value in bytes.</param>
+        template <typename Load, typename Size>
+        std::shared_ptr<Value const> getOrLoad(Key const &key, Load &&load, Size &&size)
+        {
+            if (auto value = get(key))
+                return value;
+            auto value = std::make_shared<Value const>(load());
+            put(key, value, size(*value));
+            return value;
+        }
+
+        size_t bytes() { std::lock_guard lock(m_mutex); return m_bytes; }
+        size_t hits() { std::lock_guard lock(m_mutex); return m_hits; }
+        size_t misses() { std::lock_guard lock(m_mutex); return m_misses; }
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "helpers.hpp"
+#include "live_preview.hpp"
 
 #ifndef MASKPAINTER_H_
 #define MASKPAINTER_H_
@@ -9,6 +10,8 @@ class MaskPainter
     cv::Mat m_image, m_mask, m_imageCopy, m_maskCopy;
     std::string m_windowName = "Mask Painter";
     bool m_mouseDown = false;
+    // Optional clone that follows every stroke.
+    LivePreview *m_preview = nullptr;
 
     std::vector<std::vector<cv::Point>> contours;
     std::vector<cv::Point> points;
@@ -19,11 +22,13 @@ class MaskPainter
         thiz->paintMaskHandler(event, x, y);   
     }
     void paintMaskHandler(int event, int x, int const y);
+    void showPreview(cv::Rect const &dirty);
 
     public:
         MaskPainter(std::string const &imagePath, std::string const &windowName);
         MaskPainter(std::string const &imagePath);
         void paintMask(std::string const &filename);
+        void setPreview(LivePreview *preview) { m_preview = preview; }
 
 
 
@@ -0,0 +1,27 @@
+#ifndef MEMBRANE_H_
+#define MEMBRANE_H_
+
+#include "mvc_plan.hpp"
+
+/*
+ * Evaluation of the membrane at the mesh vertices.
+ *
+ * For k right-hand sides (colour channels, several targets or several offsets stacked as columns), the membrane
+ * values are the product R = W * D of the V x B coordinate matrix W and the B x k matrix D of boundary differences.
+ * D is passed transposed, as a k x B CoordinateMatrix: row c holds the values of right-hand side c for every boundary point.
+ * R is returned row-major, V x k: R[v * k + c] is the membrane value of right-hand side c at mesh vertex v.
+ *
+ * The dense product is cache blocked: every thread owns a block of rows of W, walks the boundary in slices that fit the L1
+ * cache and computes all right-hand sides of a 4 x 4 register tile from each slice, so W is streamed from memory once per
+ * batch no matter how many right-hand sides there are.
+ *
+ * Compressed coordinates (see CompressedCoordinates) are decoded on the fly, so only the compact weights are read from
+ * memory; the dense kernel decodes a boundary slice once and reuses it for every right-hand side.
+ */
+
+std::vector<double> evaluateMembranes(MVCPlan const &plan, CoordinateMatrix const &values);
+void denseMembranes(CoordinateMatrix const &w, CoordinateMatrix const &values, double *r);
+void sparseMembranes(SparseCoordinates const &w, CoordinateMatrix const &values, double *r);
+void compressedMembranes(CompressedCoordinates const &w, CoordinateMatrix const &values, double *r);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef MESHER_H_
+#define MESHER_H_
+
+#include "adaptive_mesh.hpp"
+#include "mvc_plan.hpp"
+
+/// <summary>
+/// Builds the adaptive mesh of one mask component: vertices, and triangles covering the inside of the boundary that
+/// refer to them by index. Meshers are stateless, so one instance may mesh several boundaries concurrently.
+/// </summary>
+class Mesher
+{
+    public:
+        virtual ~Mesher() = default;
+
+        virtual void mesh(Boundary const &boundary, std::vector<Point_2> &vertices, std::vector<std::array<int, 3>> &triangles) const = 0;
+
+        static std::unique_ptr<Mesher> create(MeshBackend backend);
+};
+
+/// <summary>
+/// Constrained Delaunay refinement of the boundary with CGAL (see AdaptiveMesh).
+/// </summary>
+class CGALMesher : public Mesher
+{
+    public:
+        void mesh(Boundary const &boundary, std::vector<Point_2> &vertices, std::vector<std::array<int, 3>> &triangles) const override;
+};
+
+/// <summary>
+/// Mesher specialized for the contours of pixel masks, whose consecutive points are 8-neighbours on the integer grid.
+/// The bounding square of the boundary is split into a quadtree: cells are split down to single pixels where a boundary
+/// point lies within one cell size of them, and otherwise only while they are larger than maxCell, which grades the
+/// mesh from the boundary into the interior. Pixel cells are cut along the boundary edges that run through them (their
+/// sides or diagonals), so the mesh follows the boundary exactly without any predicates or refinement; larger cells are
+/// fanned around their centre, through the corners of the smaller neighbours on their sides.
+/// </summary>
+class QuadtreeMesher : public Mesher
+{
+    int m_maxCell;
+
+    public:
+        // Largest cell side in pixels; 16 matches the size bound of the CGAL criteria.
+        explicit QuadtreeMesher(int maxCell = 16) : m_maxCell(maxCell) {}
+
+        void mesh(Boundary const &boundary, std::vector<Point_2> &vertices, std::vector<std::array<int, 3>> &triangles) const override;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef MVCKERNEL_H_
+#define MVCKERNEL_H_
+
+#include "geometry.hpp"
+
+#include <unordered_map>
+
+/// <summary>
+/// Vectorized computation of dense mean-value coordinates.
+///
+/// The boundary is kept in structure-of-arrays buffers of scalar type T (float or double). For every boundary edge (p_i, p_i+1)
+/// the half-angle tangent is computed without trigonometry as tan(a_i / 2) = (d_i x d_i+1) / (|d_i| |d_i+1| + d_i . d_i+1),
+/// where d_i = p_i - x, and the weight of p_i is (tan(a_i-1 / 2) + tan(a_i / 2)) / |d_i|.
+/// Loops run over boundary points with SIMD lanes, and `lanes` query vertices are processed together so that every boundary
+/// point that is loaded is reused for all of them. A boundary with holes has several rings; their edges all contribute and
+/// the weights are normalized over all of them.
+///
+/// MVCSolver::mvc is the scalar reference implementation of the same coordinates.
+/// </summary>
+template <typename T>
+class MVCKernel
+{
+    // Closed boundary polygons: every ring is followed by a copy of its first point, so ring r starts at m_start[r] + r.
+    std::vector<T> m_x, m_y;
+    std::vector<int> m_start;
+    // 1 for the entries that pair the closing point of a ring with the first point of the next ring, which are no edge.
+    std::vector<unsigned char> m_seam;
+    std::unordered_map<Point_2, int> m_index;
+
+    public:
+        static constexpr int lanes = 4;
+
+        MVCKernel(Boundary const &boundary);
+
+        int size() const { return m_start.back(); }
+        int boundaryIndex(Point_2 const &p) const;
+        void compute(std::span<Point_2 const> xs, std::span<double *const> rows) const;
+
+    private:
+        void computeBlock(std::array<Point_2, lanes> const &xs, std::array<double *, lanes> const &rows, int count, std::vector<T> &scratch) const;
+        void computeOnEdge(Point_2 const &x, double *row) const;
+};
+
+extern template class MVCKernel<float>;
+extern template class MVCKernel<double>;
+
+#endif
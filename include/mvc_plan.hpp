@@ -0,0 +1,296 @@
+#ifndef MVCPLAN_H_
+#define MVCPLAN_H_
+
+#include "geometry.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+/// <summary>
+/// How the boundary is sampled when computing the mean-value coordinates of a mesh vertex.
+/// </summary>
+enum class Sampling : uint32_t
+{
+    // Every boundary point gets a weight.
+    Dense = 0,
+    // The boundary is sampled densely near the vertex and coarsely far away from it (Section 4 of the paper).
+    Hierarchical = 1
+};
+
+struct SamplingOptions
+{
+    Sampling mode = Sampling::Dense;
+    // Hierarchical mode only: a boundary segment is subdivided while its length exceeds epsilon times its distance
+    // to the vertex. Smaller values are more accurate, larger values give fewer weights per vertex.
+    double epsilon = 0.5;
+};
+
+/// <summary>
+/// Which mesher builds the adaptive mesh of a boundary (see mesher.hpp).
+/// </summary>
+enum class MeshBackend : uint32_t
+{
+    // Constrained Delaunay refinement with CGAL: good triangle shapes for any polygon.
+    CGAL = 0,
+    // Quadtree graded from the boundary to the interior: much faster, for the pixel-grid contours of masks only.
+    Quadtree = 1
+};
+
+/// <summary>
+/// Weight of a single boundary point in a sparse list of mean-value coordinates.
+/// </summary>
+struct BoundaryWeight
+{
+    int index;
+    double weight;
+};
+
+/// <summary>
+/// Dense mean-value coordinates as one contiguous row-major matrix: row i holds the weights of mesh vertex i for every
+/// boundary point. Rows are padded to a multiple of the alignment so that every row starts on a cache line.
+/// The storage is either owned or a view of memory kept alive by someone else (e.g. a mapped plan file).
+/// </summary>
+class CoordinateMatrix
+{
+    size_t m_rows = 0, m_cols = 0, m_stride = 0;
+    std::shared_ptr<double> m_data;
+
+    public:
+        static constexpr size_t alignment = 64;
+        static constexpr size_t stride(size_t cols) { return (cols * sizeof(double) + alignment - 1) / alignment * alignment / sizeof(double); }
+
+        CoordinateMatrix() = default;
+        CoordinateMatrix(size_t rows, size_t cols);
+        CoordinateMatrix(size_t rows, size_t cols, std::shared_ptr<double> data);
+
+        size_t rows() const { return m_rows; }
+        size_t cols() const { return m_cols; }
+        size_t stride() const { return m_stride; }
+        bool empty() const { return m_rows == 0; }
+
+        double *row(size_t i) { return m_data.get() + i * m_stride; }
+        double const *row(size_t i) const { return m_data.get() + i * m_stride; }
+};
+
+/// <summary>
+/// Sparse mean-value coordinates in compressed-row form: the weights of vertex i are weights[rows[i]] up to weights[rows[i + 1]].
+/// </summary>
+struct SparseCoordinates
+{
+    std::vector<int64_t> rows {0};
+    std::vector<BoundaryWeight> weights;
+
+    std::span<BoundaryWeight const> row(size_t i) const { return std::span<BoundaryWeight const>(weights).subspan(rows[i], rows[i + 1] - rows[i]); }
+};
+
+/// <summary>
+/// Storage format of compressed mean-value coordinates (see CompressedCoordinates).
+/// </summary>
+enum class WeightFormat : uint32_t
+{
+    Double = 0,
+    Float = 1,
+    // IEEE half precision: 11 significant bits.
+    Half = 2,
+    // The upper half of a float: 8 significant bits, but the range of a float.
+    BFloat16 = 3,
+    // Signed integers scaled by a per-row factor, so that the largest weight of a row maps to the largest integer.
+    Int16 = 4,
+    Int8 = 5
+};
+
+struct CompressionOptions
+{
+    WeightFormat format = WeightFormat::Double;
+    // Weights smaller in magnitude than threshold times the largest weight of their row are dropped, and the remaining
+    // weights of the row rescaled to the same sum. 0 keeps every weight.
+    double threshold = 0.0;
+};
+
+/// <summary>
+/// Conversion between weights and their stored representation. Integer formats store the weight divided by the scale
+/// of its row; the others store the weight itself and have a scale of 1.
+/// </summary>
+template<WeightFormat F> struct WeightCodec;
+
+template<> struct WeightCodec<WeightFormat::Double>
+{
+    using Stored = double;
+    static constexpr double range = 0.0;
+    static Stored encode(double w) { return w; }
+    static double decode(Stored s) { return s; }
+};
+
+template<> struct WeightCodec<WeightFormat::Float>
+{
+    using Stored = float;
+    static constexpr double range = 0.0;
+    static Stored encode(double w) { return static_cast<float>(w); }
+    static float decode(Stored s) { return s; }
+};
+
+template<> struct WeightCodec<WeightFormat::Half>
+{
+    using Stored = uint16_t;
+    static constexpr double range = 0.0;
+
+    // Round to nearest even, with subnormals; weights never overflow the half range.
+    static Stored encode(double w)
+    {
+        constexpr uint32_t f16max = (127 + 16) << 23, denormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+        auto f = std::bit_cast<uint32_t>(static_cast<float>(w));
+        auto const sign = f & 0x80000000u;
+        f ^= sign;
+
+        uint32_t h;
+        if (f >= f16max)
+            h = 0x7c00;
+        else if (f < (113u << 23))
+            h = std::bit_cast<uint32_t>(std::bit_cast<float>(f) + std::bit_cast<float>(denormMagic)) - denormMagic;
+        else
+        {
+            auto const odd = (f >> 13) & 1;
+            f += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + odd;
+            h = f >> 13;
+        }
+        return static_cast<Stored>(h | (sign >> 16));
+    }
+
+    // Branchless: the exponent bias is fixed up by a multiplication, which also normalizes subnormals. Infinities and NaNs
+    // are not restored, as weights are always finite.
+    static float decode(Stored s)
+    {
+        auto const magnitude = std::bit_cast<float>(static_cast<uint32_t>(s & 0x7fff) << 13) * 0x1p112f;
+        return std::bit_cast<float>(std::bit_cast<uint32_t>(magnitude) | (static_cast<uint32_t>(s & 0x8000) << 16));
+    }
+};
+
+template<> struct WeightCodec<WeightFormat::BFloat16>
+{
+    using Stored = uint16_t;
+    static constexpr double range = 0.0;
+
+    static Stored encode(double w)
+    {
+        auto const f = std::bit_cast<uint32_t>(static_cast<float>(w));
+        return static_cast<Stored>((f + 0x7fff + ((f >> 16) & 1)) >> 16);
+    }
+
+    static float decode(Stored s) { return std::bit_cast<float>(static_cast<uint32_t>(s) << 16); }
+};
+
+template<> struct WeightCodec<WeightFormat::Int16>
+{
+    using Stored = int16_t;
+    static constexpr double range = 32767.0;
+    static Stored encode(double w) { return static_cast<Stored>(std::clamp(std::round(w), -range, range)); }
+    static float decode(Stored s) { return s; }
+};
+
+template<> struct WeightCodec<WeightFormat::Int8>
+{
+    using Stored = int8_t;
+    static constexpr double range = 127.0;
+    static Stored encode(double w) { return static_cast<Stored>(std::clamp(std::round(w), -range, range)); }
+    static float decode(Stored s) { return s; }
+};
+
+struct MVCPlan;
+
+/// <summary>
+/// Mean-value coordinates in a compact format, for plans that are kept in memory: rows of reduced precision weights,
+/// optionally with the smallest weights dropped. Without dropping, dense coordinates keep their dense layout and the
+/// boundary indices are implicit; otherwise row i holds the boundary indices and weights of entries rows[i] up to rows[i + 1].
+/// Every row keeps the sum of its weights up to the rounding of a single weight, so constant boundary values stay nearly exact.
+/// </summary>
+class CompressedCoordinates
+{
+    WeightFormat m_format = WeightFormat::Double;
+    size_t m_cols = 0;
+    bool m_dense = false;
+    std::vector<int64_t> m_rows {0};
+    std::vector<int32_t> m_indices;
+    // One factor per row for the integer formats, empty for the others.
+    std::vector<float> m_scales;
+    std::vector<uint8_t> m_data;
+    // Largest L1 distance of a row to the uncompressed weights of the same vertex.
+    double m_maxError = 0.0;
+
+    template<WeightFormat F>
+    static CompressedCoordinates compressAs(MVCPlan const &plan, CompressionOptions const &options);
+
+    public:
+        static CompressedCoordinates compress(MVCPlan const &plan, CompressionOptions const &options);
+
+        WeightFormat format() const { return m_format; }
+        size_t rows() const { return m_rows.size() - 1; }
+        size_t cols() const { return m_cols; }
+        bool empty() const { return rows() == 0; }
+        bool dense() const { return m_dense; }
+        size_t bytes() const
+        {
+            return empty() ? 0 : m_data.size() + m_indices.size() * sizeof(int32_t) + m_scales.size() * sizeof(float) + m_rows.size() * sizeof(int64_t);
+        }
+
+        // A membrane value computed from the compressed weights differs from the exact one by at most maxError times
+        // the largest magnitude of the boundary values.
+        double maxError() const { return m_maxError; }
+
+        size_t size(size_t i) const { return static_cast<size_t>(m_rows[i + 1] - m_rows[i]); }
+        double scale(size_t i) const { return m_scales.empty() ? 1.0 : m_scales[i]; }
+        int32_t const *indices(size_t i) const { return m_indices.data() + m_rows[i]; }
+        template<WeightFormat F>
+        typename WeightCodec<F>::Stored const *weights(size_t i) const { return reinterpret_cast<typename WeightCodec<F>::Stored const *>(m_data.data()) + m_rows[i]; }
+};
+
+/// <summary>
+/// Everything the solver needs that depends only on the boundary of one mask component: the adaptive mesh
+/// and the mean-value coordinates of its vertices. It can be reused for any source/target pair.
+/// Mesh vertices are referred to by their index in `vertices`.
+/// </summary>
+struct MVCPlan
+{
+    Boundary boundary;
+    std::vector<Point_2> vertices;
+    std::vector<std::array<int, 3>> triangles;
+    MeshBackend mesher = MeshBackend::CGAL;
+    SamplingOptions sampling;
+    // Dense sampling: one weight per boundary point for every vertex.
+    CoordinateMatrix coordinates;
+    // Hierarchical sampling: only the sampled boundary points of every vertex.
+    SparseCoordinates sparseCoordinates;
+    // Either of the above in a compact format; when present, the membrane is evaluated from it.
+    CompressedCoordinates compressedCoordinates;
+
+    size_t bytes() const;
+};
+
+/// <summary>
+/// Immutable result of the preprocessing stage for a whole mask: a private copy of the mask and the plans of all of its
+/// components, built by MVCSolver::prepare. Copies share the same state, so a plan is cheap to pass around and any
+/// number of threads may solve with it concurrently; nothing in it changes after it is built.
+/// </summary>
+class ClonePlan
+{
+    struct State
+    {
+        cv::Mat mask;
+        std::vector<MVCPlan> components;
+    };
+    std::shared_ptr<State const> m_state;
+
+    public:
+        ClonePlan() = default;
+        ClonePlan(cv::Mat const &mask, std::vector<MVCPlan> components);
+
+        bool empty() const { return !m_state; }
+        // Single-channel 8-bit mask; non-zero pixels are inside.
+        cv::Mat const &mask() const { return m_state->mask; }
+        std::vector<MVCPlan> const &components() const { return m_state->components; }
+        size_t bytes() const;
+};
+
+#endif
@@ -2,16 +2,110 @@
 #define MVCC_H_
 
 #include "adaptive_mesh.hpp"
+#include "arena.hpp"
+#include "boundary.hpp"
 #include "geometry.hpp"
+#include "membrane.hpp"
+#include "mesher.hpp"
+#include "mvc_kernel.hpp"
+#include "pixel_format.hpp"
+#include "plan_cache.hpp"
+#include "rasterizer.hpp"
+#include "span_mask.hpp"
+#include "tile_store.hpp"
+#include "trace.hpp"
 
+#include <functional>
+#include <future>
+#include <span>
+
+/// <summary>
+/// One target of a batch: the image the source patch is cloned into and the offset of the mask inside it.
+/// </summary>
+struct CloneJob
+{
+    cv::Mat dest;
+    glm::vec2 offset;
+};
+
+/// <summary>
+/// One patch of a composite: the source image, the mask of the region to clone and the offset of the mask inside the target.
+/// </summary>
+struct PatchJob
+{
+    cv::Mat src;
+    cv::Mat mask;
+    glm::vec2 offset;
+};
+
+/// <summary>
+/// Called by a progressive solve with the result of every pyramid level, coarsest first; level 0 is the full solve.
+/// </summary>
+using LevelCallback = std::function<void(int level, cv::Mat const &result)>;
+
+/// <summary>
+/// Floating-point type of the per-pixel arithmetic: the interpolation of the membrane and the final intensities.
+/// Single precision processes twice as many values per SIMD register and halves the size of the interpolated values.
+/// </summary>
+enum class Precision
+{
+    Single,
+    Double
+};
+
+/// <summary>
+/// Mean-value coordinates cloning. Apart from the setters, all member functions are const and may run concurrently;
+/// the solver holds only its settings. prepare builds an immutable plan of a mask that concurrent solves can share.
+/// Images may be 8-bit, 16-bit or float with 1, 3 or 4 channels (see PixelFormat); the source and the targets of a solve
+/// must have the same type, and so has the result.
+/// </summary>
 class MVCSolver
 {
-    AdaptiveMesh m_mesh;
+    std::optional<PlanCache> m_cache;
+    SamplingOptions m_sampling;
+    MeshBackend m_mesher = MeshBackend::CGAL;
+    // Boundary simplification tolerance in pixels, see boundary.hpp.
+    double m_tolerance = 0.0;
+    // Storage of the coordinates of the plans handed out by plans(); plans are cached uncompressed.
+    std::optional<CompressionOptions> m_compression;
+    Precision m_precision = Precision::Double;
     public:
         MVCSolver() = default;
+        MVCSolver(PlanCache const &cache) : m_cache(cache) {}
+
+        void setSampling(SamplingOptions const &sampling) { m_sampling = sampling; }
+        void setPrecision(Precision precision) { m_precision = precision; }
+        void setMesher(MeshBackend mesher) { m_mesher = mesher; }
+        void setBoundaryTolerance(double tolerance) { m_tolerance = tolerance; }
+        void setCompression(CompressionOptions const &compression) { m_compression = compression; }
+
+        std::vector<double> mvc(Point_2 const &p, Boundary const &ps) const;
+        std::vector<BoundaryWeight> mvcHierarchical(Point_2 const &p, Boundary const &ps, std::vector<double> const &arc, double epsilon) const;
+        MVCPlan meshing(Boundary const &boundary) const;
+        void coordinates(MVCPlan &plan) const;
+        void compress(MVCPlan &plan) const;
+        MVCPlan preprocessing(Boundary const &boundary) const;
+        std::vector<MVCPlan> plans(cv::Mat const &mask) const;
+        ClonePlan prepare(cv::Mat const &mask) const;
+        static void checkPlacement(cv::Size const &src, cv::Mat const &mask, cv::Size const &dest, glm::vec2 const &offset);
+        cv::Mat solve(ClonePlan const &plan, cv::Mat const &src, cv::Mat const &dest, glm::vec2 const &offset) const;
+        cv::Mat solve(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset) const;
+        std::vector<cv::Mat> solve(cv::Mat const &src, cv::Mat const &mask, std::vector<CloneJob> const &jobs) const;
+        std::vector<cv::Mat> solve(std::vector<MVCPlan> const &plans, cv::Mat const &src, cv::Mat const &mask, std::vector<CloneJob> const &jobs) const;
+        size_t solve(cv::Mat const &src, cv::Mat const &mask, TileStore &dest, glm::vec2 const &offset) const;
+        cv::Rect render(std::vector<MVCPlan> const &plans, cv::Mat const &src, SpanMask const &region, cv::Mat const &dest, cv::Mat &frame, cv::Point const &offset) const;
+        cv::Mat composite(cv::Mat const &dest, std::vector<PatchJob> const &patches) const;
+        cv::Mat preview(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset, int level) const;
+        std::future<cv::Mat> solveProgressive(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset, int levels, LevelCallback const &onLevel, bool refine = true) const;
 
-        std::vector<double> mvc(Point_2 const &p, const std::vector<Point_2> &ps);
-        std::unordered_map<Point_2, std::vector<double>> preprocessing(cv::Mat const &mask, std::vector<Point_2> const &boundary);
-        cv::Mat solve(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset);
+    private:
+        template <typename Scalar, typename Format>
+        std::vector<cv::Mat> solveAs(std::vector<MVCPlan> const &plans, cv::Mat const &src, cv::Mat const &mask, std::vector<CloneJob> const &jobs) const;
+        template <typename Scalar, typename Format>
+        cv::Rect renderAs(std::vector<MVCPlan> const &plans, cv::Mat const &src, SpanMask const &region, cv::Mat const &dest, cv::Mat &frame, cv::Point const &offset) const;
+        template <typename Scalar, typename Format>
+        cv::Mat previewAs(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset, int level) const;
+        template <typename Scalar, typename Format>
+        cv::Mat compositeAs(cv::Mat const &dest, std::vector<PatchJob> const &patches) const;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "helpers.hpp"
+#include "live_preview.hpp"
+
+#ifndef PATCHPLACER_H_
+#define PATCHPLACER_H_
+
+class PatchPlacer
+{
+    PlacementPreview &m_preview;
+    std::string m_windowName = "Patch Placer";
+    bool m_dragging = false;
+    // Cursor position relative to the offset of the patch when the drag started.
+    cv::Point m_grab;
+    // Offset the cursor asks for; mouse events only record it, the window loop renders at most once per frame.
+    cv::Point m_target;
+
+    static void placeHandlerStatic(int event, int x, int y, int flags, void* that)
+    {
+        PatchPlacer* thiz = static_cast<PatchPlacer*>(that);
+        thiz->placeHandler(event, x, y);
+    }
+    void placeHandler(int event, int x, int y);
+
+    public:
+        PatchPlacer(PlacementPreview &preview, std::string const &windowName);
+        PatchPlacer(PlacementPreview &preview);
+        bool place();
+};
+
+#endif
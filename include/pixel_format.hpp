@@ -0,0 +1,72 @@
+#ifndef PIXELFORMAT_H_
+#define PIXELFORMAT_H_
+
+#include "helpers.hpp"
+
+#include <stdexcept>
+
+/*
+ * Pixel formats the solver is compiled for: 8-bit, 16-bit and 32-bit float channels, with 1, 3 or 4 channels.
+ * The solver core is a template over the format, and visitPixelFormat picks the instance that matches a cv::Mat type.
+ */
+
+template <typename Channel> struct ChannelDepth;
+template <> struct ChannelDepth<uchar> { static constexpr int value = CV_8U; };
+template <> struct ChannelDepth<ushort> { static constexpr int value = CV_16U; };
+template <> struct ChannelDepth<float> { static constexpr int value = CV_32F; };
+
+/// <summary>
+/// Compile-time description of the pixels of an image: channel type and channel count.
+/// </summary>
+template <typename Channel, int Channels>
+struct PixelFormat
+{
+    using channel_type = Channel;
+    using pixel_type = cv::Vec<Channel, Channels>;
+    static constexpr int channels = Channels;
+    static constexpr int type = CV_MAKETYPE(ChannelDepth<Channel>::value, Channels);
+};
+
+/// <summary>
+/// Calls fn with the PixelFormat matching an OpenCV image type.
+/// </summary>
+/// <param name="type">Image type, e.g. CV_8UC3.</param>
+/// <param name="fn">Generic callable taking a PixelFormat by value; every instance must return the same type.</param>
+/// <returns>What fn returns.</returns>
+template <typename Fn>
+decltype(auto) visitPixelFormat(int type, Fn &&fn)
+{
+    switch (type)
+    {
+        case CV_8UC1: return fn(PixelFormat<uchar, 1>{});
+        case CV_8UC3: return fn(PixelFormat<uchar, 3>{});
+        case CV_8UC4: return fn(PixelFormat<uchar, 4>{});
+        case CV_16UC1: return fn(PixelFormat<ushort, 1>{});
+        case CV_16UC3: return fn(PixelFormat<ushort, 3>{});
+        case CV_16UC4: return fn(PixelFormat<ushort, 4>{});
+        case CV_32FC1: return fn(PixelFormat<float, 1>{});
+        case CV_32FC3: return fn(PixelFormat<float, 3>{});
+        case CV_32FC4: return fn(PixelFormat<float, 4>{});
+        default: throw std::invalid_argument("unsupported image type " + std::to_string(type) + "; expected 8-bit, 16-bit or float images with 1, 3 or 4 channels");
+    }
+}
+
+/// <summary>
+/// Copies an RGB image of the framework (e.g. an HDR image read with stbi_loadf) into a BGR float image.
+/// </summary>
+static inline cv::Mat toMat(ImageRGB const &image)
+{
+    cv::Mat mat(image.height, image.width, CV_32FC3);
+    for (int y = 0; y < image.height; ++y)
+    {
+        auto *row = mat.ptr<cv::Vec3f>(y);
+        for (int x = 0; x < image.width; ++x)
+        {
+            auto const &p = image.data[static_cast<size_t>(y) * image.width + x];
+            row[x] = cv::Vec3f(p.b, p.g, p.r);
+        }
+    }
+    return mat;
+}
+
+#endif
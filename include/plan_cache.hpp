@@ -0,0 +1,63 @@
+#ifndef PLANCACHE_H_
+#define PLANCACHE_H_
+
+#include "mvc_plan.hpp"
+
+#include <cstdint>
+#include <optional>
+
+/*
+ * On-disk cache of solver plans, keyed by a hash of the boundary of a mask component, the sampling and the mesher.
+ *
+ * Every plan is stored in its own file <dir>/<key>.mvcplan with the layout below (native endianness):
+ *   PlanHeader
+ *   double   boundary[boundaryCount][2]
+ *   double   vertices[vertexCount][2]
+ *   int32_t  triangles[triangleCount][3]     (indices into vertices)
+ *   int32_t  rings[ringCount + 1]            (ring r of the boundary is rings[r] up to rings[r + 1])
+ *   padding up to a multiple of CoordinateMatrix::alignment bytes
+ * followed by, for dense sampling:
+ *   double   weights[vertexCount][stride]    (the CoordinateMatrix rows, padding included)
+ * or, for hierarchical sampling:
+ *   int64_t  rows[vertexCount + 1]           (weights of vertex i are rows[i] up to rows[i + 1])
+ *   double   weights[weightCount]
+ *   int32_t  indices[weightCount]            (boundary index of every weight)
+ *
+ * Dense coordinates are used straight from the mapped file, without copying.
+ */
+
+struct PlanHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sampling;
+    uint32_t mesher;
+    uint64_t key;
+    double epsilon;
+    uint64_t boundaryCount;
+    uint64_t vertexCount;
+    uint64_t triangleCount;
+    uint64_t weightCount;
+    uint64_t stride;
+    uint64_t ringCount;
+};
+
+class PlanCache
+{
+    std::filesystem::path m_dir;
+    bool m_rebuild = false;
+
+    public:
+        // Bump whenever the file layout or the way plans are computed changes.
+        static constexpr uint32_t version = 5;
+
+        PlanCache(std::filesystem::path const &dir, bool rebuild = false);
+
+        std::optional<MVCPlan> load(Boundary const &boundary, SamplingOptions const &sampling, MeshBackend mesher) const;
+        void store(MVCPlan const &plan) const;
+
+        static uint64_t key(Boundary const &boundary, SamplingOptions const &sampling, MeshBackend mesher);
+        std::filesystem::path path(uint64_t key) const;
+};
+
+#endif
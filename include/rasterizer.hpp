@@ -0,0 +1,127 @@
+#ifndef RASTERIZER_H_
+#define RASTERIZER_H_
+
+#include "helpers.hpp"
+#include "span_mask.hpp"
+
+#include <memory_resource>
+
+
+/*
+ * Scanline rasterization of the adaptive mesh.
+ *
+ * Pixels are sampled at integer coordinates. A pixel (x, y) belongs to a triangle when
+ * left(y) <= x < right(y) and top <= y < bottom, so triangles that share an edge never
+ * both claim a pixel and never leave a gap between them. This makes it safe to rasterize
+ * different triangles of the same mesh concurrently into the same output.
+ */
+
+/// <summary>
+/// A mesh triangle together with the value that has to be interpolated at each of its vertices.
+/// </summary>
+template <typename T>
+struct RasterTriangle
+{
+	std::array<Point_2, 3> v;
+	std::array<T, 3> value;
+};
+
+/// <summary>
+/// Triangles of the meshes of one solve, allocated from the arena of the solve (see SolveArena) or the default heap.
+/// </summary>
+template <typename T>
+using RasterTriangles = std::pmr::vector<RasterTriangle<T>>;
+
+static inline std::pair<int, int> clipRows(cv::Rect const &rect)
+{
+	return {rect.y, rect.y + rect.height};
+}
+
+template <typename Fn>
+static inline void clipSpan(cv::Rect const &rect, int, int begin, int end, Fn &&fn)
+{
+	auto const b = std::max(begin, rect.x);
+	auto const e = std::min(end, rect.x + rect.width);
+	if (b < e) fn(b, e);
+}
+
+/// <summary>
+/// Computes the x coordinate where edge (a, b) crosses scanline y.
+/// The end points are put in a canonical order first, so that two triangles sharing the edge get bit-identical results.
+/// </summary>
+static inline double edgeCrossing(Point_2 const &a, Point_2 const &b, double y)
+{
+	auto const &lo = (a.y() < b.y() || (a.y() == b.y() && a.x() < b.x())) ? a : b;
+	auto const &hi = (&lo == &a) ? b : a;
+
+	return lo.x() + (y - lo.y()) * (hi.x() - lo.x()) / (hi.y() - lo.y());
+}
+
+/// <summary>
+/// Scan-converts a single triangle and linearly interpolates its vertex values over the covered pixels.
+/// </summary>
+/// <param name="t">Triangle and its per-vertex values.</param>
+/// <param name="clip">Only pixels inside this rectangle or mask are visited.</param>
+/// <param name="fn">Callback invoked as fn(x, y, value) for every covered pixel.</param>
+template <typename T, typename Clip, typename Fn>
+static inline void rasterizeTriangle(RasterTriangle<T> const &t, Clip const &clip, Fn &&fn)
+{
+	// Sort vertices (and their values) top to bottom.
+	std::array<int, 3> order {0, 1, 2};
+	std::sort(order.begin(), order.end(), [&t](int a, int b) { return t.v[a].y() < t.v[b].y(); });
+	auto const &v0 = t.v[order[0]];
+	auto const &v1 = t.v[order[1]];
+	auto const &v2 = t.v[order[2]];
+	auto const &r0 = t.value[order[0]];
+	auto const &r1 = t.value[order[1]];
+	auto const &r2 = t.value[order[2]];
+
+	// Twice the signed area. Degenerate triangles cover no pixels.
+	auto const area = (v1.x() - v0.x()) * (v2.y() - v0.y()) - (v2.x() - v0.x()) * (v1.y() - v0.y());
+	if (area == 0.0) return;
+
+	// The interpolated value is a plane over the triangle, so it changes by a constant amount per pixel step.
+	T const dx = ((r1 - r0) * (v2.y() - v0.y()) - (r2 - r0) * (v1.y() - v0.y())) * (1.0 / area);
+	T const dy = ((r2 - r0) * (v1.x() - v0.x()) - (r1 - r0) * (v2.x() - v0.x())) * (1.0 / area);
+
+	auto const [clipBegin, clipEnd] = clipRows(clip);
+	auto const yBegin = std::max(static_cast<int>(std::ceil(v0.y())), clipBegin);
+	auto const yEnd = std::min(static_cast<int>(std::ceil(v2.y())), clipEnd);
+	for (int y = yBegin; y < yEnd; ++y)
+	{
+		// Long edge v0-v2 on one side, v0-v1 or v1-v2 on the other.
+		auto const xa = edgeCrossing(v0, v2, y);
+		auto const xb = (y < v1.y()) ? edgeCrossing(v0, v1, y) : edgeCrossing(v1, v2, y);
+
+		auto const xBegin = static_cast<int>(std::ceil(std::min(xa, xb)));
+		auto const xEnd = static_cast<int>(std::ceil(std::max(xa, xb)));
+		if (xBegin >= xEnd) continue;
+
+		auto const rowValue = r0 + dy * (y - v0.y());
+		clipSpan(clip, y, xBegin, xEnd, [&](int begin, int end)
+		{
+			T value = rowValue + dx * (begin - v0.x());
+			for (int x = begin; x < end; ++x)
+			{
+				fn(x, y, value);
+				value += dx;
+			}
+		});
+	}
+}
+
+/// <summary>
+/// Rasterizes all triangles of a mesh in parallel. Every pixel is visited at most once.
+/// </summary>
+/// <param name="triangles">Contiguous range of triangles and their per-vertex values.</param>
+/// <param name="clip">Only pixels inside this rectangle or mask are visited.</param>
+/// <param name="fn">Callback invoked as fn(x, y, value) for every covered pixel. Must be safe to call concurrently for different pixels.</param>
+template <typename Triangles, typename Clip, typename Fn>
+static inline void rasterize(Triangles const &triangles, Clip const &clip, Fn &&fn)
+{
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (int i = 0; i < static_cast<int>(triangles.size()); ++i)
+		rasterizeTriangle(triangles[i], clip, fn);
+}
+
+#endif
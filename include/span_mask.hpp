@@ -0,0 +1,93 @@
+#ifndef SPANMASK_H_
+#define SPANMASK_H_
+
+#include "helpers.hpp"
+
+/// <summary>
+/// A horizontal run of masked pixels [begin, end) on row y.
+/// </summary>
+struct Span
+{
+    int y;
+    int begin;
+    int end;
+};
+
+/// <summary>
+/// Run-length (row-span) representation of a binary mask.
+/// Built once from the mask image and limited to the mask's bounding box, so that iterating the
+/// masked pixels costs O(spans + pixels inside the mask) instead of a test per pixel of the image.
+/// </summary>
+class SpanMask
+{
+    cv::Rect m_bbox;
+    std::vector<Span> m_spans;
+    // Spans of row y are m_spans[m_rows[y - m_bbox.y]] up to m_spans[m_rows[y - m_bbox.y + 1]].
+    std::vector<int> m_rows;
+
+    public:
+        SpanMask() = default;
+        SpanMask(cv::Mat const &mask);
+
+        cv::Rect bbox() const { return m_bbox; }
+        bool empty() const { return m_spans.empty(); }
+        size_t area() const;
+        std::span<Span const> spans() const { return m_spans; }
+        std::span<Span const> row(int y) const;
+        bool contains(int x, int y) const;
+        SpanMask clip(cv::Rect const &rect) const;
+
+        template <typename Fn> void forEachSpan(Fn &&fn) const;
+        template <typename Fn> void forEach(Fn &&fn) const;
+
+    private:
+        void build(std::vector<Span> &&spans);
+};
+
+/// <summary>
+/// Calls fn(y, begin, end) for every span of the mask. Rows are processed in parallel.
+/// </summary>
+template <typename Fn>
+void SpanMask::forEachSpan(Fn &&fn) const
+{
+    #pragma omp parallel for schedule(static)
+    for (int y = m_bbox.y; y < m_bbox.y + m_bbox.height; ++y)
+        for (auto const &s : row(y))
+            fn(s.y, s.begin, s.end);
+}
+
+/// <summary>
+/// Calls fn(x, y) for every pixel inside the mask. Rows are processed in parallel.
+/// </summary>
+template <typename Fn>
+void SpanMask::forEach(Fn &&fn) const
+{
+    forEachSpan([&fn](int y, int begin, int end)
+    {
+        for (int x = begin; x < end; ++x)
+            fn(x, y);
+    });
+}
+
+/*
+ * Row clipping used by the rasterizer, so that a triangle can be clipped either by a rectangle or by a mask.
+ */
+
+static inline std::pair<int, int> clipRows(SpanMask const &mask)
+{
+    auto const bbox = mask.bbox();
+    return {bbox.y, bbox.y + bbox.height};
+}
+
+template <typename Fn>
+static inline void clipSpan(SpanMask const &mask, int y, int begin, int end, Fn &&fn)
+{
+    for (auto const &s : mask.row(y))
+    {
+        auto const b = std::max(begin, s.begin);
+        auto const e = std::min(end, s.end);
+        if (b < e) fn(b, e);
+    }
+}
+
+#endif
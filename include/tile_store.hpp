@@ -0,0 +1,61 @@
+#ifndef TILESTORE_H_
+#define TILESTORE_H_
+
+#include "helpers.hpp"
+
+#include <cstdint>
+
+namespace boost::iostreams { class mapped_file; }
+
+/*
+ * Out-of-core raster for targets too large to decode as a whole, e.g. gigapixel scans.
+ *
+ * The image is split into square tiles stored one after another in a single file, which is memory mapped read-write:
+ *   TileHeader
+ *   padding up to tileAlignment bytes
+ *   tiles[tilesY][tilesX]        row-major tiles of tileSize x tileSize pixels (edge tiles are padded to the full size),
+ *                                each padded to a multiple of tileAlignment bytes
+ * Reading or writing a window only touches the pages of the tiles it overlaps, and only the tiles that were written are
+ * dirty and written back to the file by the operating system.
+ */
+
+struct TileHeader
+{
+    char magic[8];
+    uint32_t version;
+    int32_t type;
+    uint64_t width;
+    uint64_t height;
+    uint64_t tileSize;
+};
+
+class TileStore
+{
+    std::shared_ptr<boost::iostreams::mapped_file> m_map;
+    TileHeader m_header;
+    size_t m_tileBytes = 0;
+    char *m_tiles = nullptr;
+
+    public:
+        // Bump whenever the file layout changes.
+        static constexpr uint32_t version = 1;
+        static constexpr size_t tileAlignment = 4096;
+
+        explicit TileStore(std::filesystem::path const &path);
+
+        static TileStore create(std::filesystem::path const &path, cv::Size size, int type, int tileSize = 256);
+        static TileStore import(std::filesystem::path const &image, std::filesystem::path const &path, int tileSize = 256);
+
+        cv::Size size() const { return {static_cast<int>(m_header.width), static_cast<int>(m_header.height)}; }
+        int type() const { return m_header.type; }
+        int tileSize() const { return static_cast<int>(m_header.tileSize); }
+
+        cv::Mat read(cv::Rect const &rect) const;
+        size_t write(cv::Point const &origin, cv::Mat const &img);
+
+    private:
+        std::vector<cv::Rect> tiles(cv::Rect const &rect) const;
+        char *tile(cv::Rect const &tile) const;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string>
+
+/*
+ * Lightweight instrumentation of the pipeline stages:
+ *   TRACE_SCOPE("mesh");                      wall and CPU time of the enclosing block
+ *   Trace::count("mesh.vertices", n);         adds n to a named counter
+ *   Trace::allocations()                      heap allocations of the calling thread, counted in debug builds of the executables only
+ * Nothing is recorded until Trace::enable() is called (see TraceFile); until then every probe costs one relaxed atomic load.
+ * Names must be string literals, they are stored by pointer.
+ *
+ * CPU time is the process CPU time spent while a scope was open, so it includes the OpenMP threads the stage started
+ * (CPU / wall is its effective parallelism), and concurrent scopes on other threads if there are any.
+ */
+
+enum class TraceFormat
+{
+    Summary,    // JSON object with per-stage totals, counters and peak resident memory
+    Chrome      // Chrome trace-event file, for chrome://tracing or Perfetto
+};
+
+class Trace
+{
+    static inline std::atomic<bool> s_enabled {false};
+
+    public:
+        static void enable();
+        static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        static int64_t now();
+        static void record(char const *name, int64_t start, int64_t duration, int64_t cpu);
+        static void count(char const *name, int64_t value)
+        {
+            if (enabled())
+                addCount(name, value);
+        }
+
+        static size_t peakRss();
+        static size_t allocations();
+        static void countAllocation();
+        static void write(std::ostream &out, TraceFormat format);
+
+    private:
+        static void addCount(char const *name, int64_t value);
+};
+
+/// <summary>
+/// Records the wall and CPU time between its construction and its destruction as one event of the trace.
+/// </summary>
+class TraceScope
+{
+    char const *m_name;
+    int64_t m_start = -1;
+    std::clock_t m_cpu = 0;
+
+    public:
+        explicit TraceScope(char const *name) : m_name(name)
+        {
+            if (Trace::enabled())
+            {
+                m_start = Trace::now();
+                m_cpu = std::clock();
+            }
+        }
+
+        ~TraceScope()
+        {
+            if (m_start >= 0)
+                Trace::record(m_name, m_start, Trace::now() - m_start, static_cast<int64_t>(std::clock() - m_cpu) * 1000000 / CLOCKS_PER_SEC);
+        }
+
+        TraceScope(TraceScope const &) = delete;
+        TraceScope &operator=(TraceScope const &) = delete;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope const TRACE_CONCAT(traceScope, __LINE__) {name}
+
+/// <summary>
+/// Enables tracing for its lifetime and writes the trace to a file when it is destroyed.
+/// </summary>
+class TraceFile
+{
+    std::string m_path;
+    TraceFormat m_format;
+
+    public:
+        TraceFile(std::string const &path, TraceFormat format);
+        ~TraceFile();
+
+        TraceFile(TraceFile const &) = delete;
+        TraceFile &operator=(TraceFile const &) = delete;
+};
+
+#endif
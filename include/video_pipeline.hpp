@@ -0,0 +1,49 @@
+#ifndef VIDEOPIPELINE_H_
+#define VIDEOPIPELINE_H_
+
+#include "bounded_queue.hpp"
+#include "mvc_solver.hpp"
+
+#include <opencv2/videoio.hpp>
+
+/// <summary>
+/// Wall time spent by one pipeline stage on its own work (busy) and blocked on its queues (waiting).
+/// </summary>
+struct StageTime
+{
+    double busy = 0.0;
+    double waiting = 0.0;
+};
+
+/// <summary>
+/// Summary of a pipeline run: processed frames, wall time and per-stage times (decode, solve, encode).
+/// </summary>
+struct PipelineStats
+{
+    size_t frames = 0;
+    double seconds = 0.0;
+    std::array<StageTime, 3> stages;
+
+    double fps() const { return seconds > 0.0 ? frames / seconds : 0.0; }
+    void print(std::ostream &out) const;
+};
+
+/// <summary>
+/// Clones a static source patch into every frame of a video or image sequence.
+///
+/// The plan (mesh and mean-value coordinates) is built once; every frame only recomputes its boundary differences,
+/// membrane and interpolation. Decode, solve and encode run on their own threads, connected by bounded queues, so that
+/// reading and writing frames overlap with the solve of the frames in between. Frames keep their order.
+/// </summary>
+class VideoCloner
+{
+    MVCSolver &m_solver;
+    size_t m_queueDepth;
+
+    public:
+        VideoCloner(MVCSolver &solver, size_t queueDepth = 8) : m_solver(solver), m_queueDepth(queueDepth) {}
+
+        PipelineStats run(cv::Mat const &src, cv::Mat const &mask, glm::vec2 const &offset, cv::VideoCapture &input, cv::VideoWriter &output);
+};
+
+#endif
@@ -1,29 +1,108 @@
 #include "adaptive_mesh.hpp"
 
+#include <set>
+#include <opencv2/imgcodecs.hpp>
 
 /// <summary>
 /// Create an adaptive mesh using the boundary points.
 /// </summary>
-/// <param name="v">The list of points on the boundary of source patch</param>
+/// <param name="boundary">The rings of the boundary of a source patch component: its outer contour and the contours of its holes</param>
 /// <returns>An adaptive mesh stored inside the m_cdt member</returns>
-void AdaptiveMesh::createMesh(std::vector<Point_2> const &v)
+void AdaptiveMesh::createMesh(Boundary const &boundary)
 {   
+    TRACE_SCOPE("mesh");
+
     // Clear existing mesh
     m_cdt.clear();
+    refine(boundary);
+}
+
+/// <summary>
+/// Updates the mesh after the boundary changed inside a rectangle, e.g. after a brush stroke. The vertices inside the
+/// rectangle and the constraints that are no longer boundary edges are removed, the new boundary is constrained and
+/// only the triangles around the change are refined again. Vertices elsewhere keep their positions.
+/// </summary>
+/// <param name="boundary">The new rings of the boundary.</param>
+/// <param name="dirty">Rectangle outside of which the boundary did not change.</param>
+void AdaptiveMesh::updateMesh(Boundary const &boundary, cv::Rect const &dirty)
+{
+    TRACE_SCOPE("mesh.update");
+    auto const inside = [&dirty](CDTPoint const &p)
+    {
+        return p.x() >= dirty.x && p.x() < dirty.x + dirty.width && p.y() >= dirty.y && p.y() < dirty.y + dirty.height;
+    };
+    auto const edge = [](CDTPoint const &a, CDTPoint const &b) { return a < b ? std::make_pair(a, b) : std::make_pair(b, a); };
+
+    // Remove the vertices of the changed region, with their constraints.
+    std::vector<Vertex_handle> stale;
+    for(CDT::Finite_vertices_iterator vit = m_cdt.finite_vertices_begin(); vit != m_cdt.finite_vertices_end(); vit ++)
+        if(inside(vit -> point()))
+            stale.push_back(vit);
+    for(auto v : stale){
+        m_cdt.remove_incident_constraints(v);
+        m_cdt.remove(v);
+    }
+
+    // Remove the remaining constraints that are not edges of the new boundary, which happens when the topology changes.
+    std::set<std::pair<CDTPoint, CDTPoint>> edges;
+    for(int i = 0; i < static_cast<int>(boundary.size()); i ++){
+        auto const &a = boundary[i];
+        auto const &b = boundary[boundary.next(i)];
+        edges.insert(edge(CDTPoint(a.x(), a.y()), CDTPoint(b.x(), b.y())));
+    }
+    std::vector<std::pair<Vertex_handle, Vertex_handle>> obsolete;
+    for(CDT::Finite_edges_iterator eit = m_cdt.finite_edges_begin(); eit != m_cdt.finite_edges_end(); eit ++){
+        if(!m_cdt.is_constrained(*eit)) continue;
+        auto const va = eit -> first -> vertex(CDT::cw(eit -> second));
+        auto const vb = eit -> first -> vertex(CDT::ccw(eit -> second));
+        if(!edges.count(edge(va -> point(), vb -> point())))
+            obsolete.push_back({va, vb});
+    }
+    for(auto const &[va, vb] : obsolete){
+        Face_handle f;
+        int i;
+        if(m_cdt.is_edge(va, vb, f, i))
+            m_cdt.remove_constrained_edge(f, i);
+    }
+
+    refine(boundary);
+}
 
-    // Add points to mesh and define constraints
+/// <summary>
+/// Constrains the triangulation to the boundary, refines it and numbers the vertices of the patch. Points and constraints
+/// that are already part of the triangulation are kept as they are.
+/// </summary>
+void AdaptiveMesh::refine(Boundary const &boundary)
+{
+    // Add points to mesh and define constraints, closing every ring
     std::vector<Vertex_handle> vh;
-    for(auto const &p : v)
+    for(auto const &p : boundary)
     	vh.push_back(m_cdt.insert(CDTPoint(p.x(), p.y())));
-	 for(int i = 0; i < v.size(); i ++)
-        m_cdt.insert_constraint(vh[i],vh[(i == v.size() - 1) ? 0 : (i + 1)]);
+	 for(int i = 0; i < static_cast<int>(boundary.size()); i ++)
+        m_cdt.insert_constraint(vh[i], vh[boundary.next(i)]);
 
-    // Generate mesh
-	CGAL::refine_Delaunay_mesh_2(m_cdt, Criteria(0.125,16));
+    // Generate mesh. A seed inside every hole keeps the faces of that hole out of the domain.
+    std::vector<CDTPoint> seeds;
+    for(int r = 1; r < boundary.ringCount(); r ++){
+        auto const seed = interiorPoint({boundary.begin() + boundary.rings[r], boundary.begin() + boundary.rings[r + 1]});
+        seeds.push_back(CDTPoint(seed.x(), seed.y()));
+    }
+	CGAL::refine_Delaunay_mesh_2(m_cdt, seeds.begin(), seeds.end(), Criteria(0.125,16), false);
 
-    // Add vertices to list
+    // Add vertices to list and number them, so that the rest of the pipeline can refer to a vertex by its index.
+    // Vertices left outside the domain by an update (see updateMesh) belong to no triangle and are skipped.
+    for(CDT::Finite_vertices_iterator vit = m_cdt.finite_vertices_begin(); vit != m_cdt.finite_vertices_end(); vit ++)
+        vit -> info() = -1;
+    for(CDT::Finite_faces_iterator fit = m_cdt.finite_faces_begin(); fit != m_cdt.finite_faces_end(); fit ++)
+        if(fit -> is_in_domain())
+            for(int i = 0; i < 3; i ++)
+                fit -> vertex(i) -> info() = 0;
+
+    m_vs.clear();
     for(CDT::Finite_vertices_iterator vit = m_cdt.finite_vertices_begin(); vit != m_cdt.finite_vertices_end(); vit ++){
+        if(vit -> info() < 0) continue;
         CDTPoint p = vit -> point();
+        vit -> info() = static_cast<int>(m_vs.size());
         m_vs.push_back(Point_2{p.x(),p.y()});
     }
 }
@@ -33,26 +112,40 @@ void AdaptiveMesh::createMesh(std::vector<Point_2> const &v)
 /// </summary>
 /// <param name="v">2D point within source patch.</param>
 /// <returns>The triangle in which said point lies.</returns>
-std::vector<Point_2> AdaptiveMesh::getFace(Point_2 const &v)
-{   
-    std::vector<Point_2> face;
-	auto f = m_cdt.locate(CDTPoint{v.x(), v.y()});
-    // #pragma omp parallel for
-	for(int i = 0; i < 3; i ++){
+std::array<Point_2, 3> AdaptiveMesh::getFace(Point_2 const &v) const
+{
+    auto const f = m_cdt.locate(CDTPoint{v.x(), v.y()});
+    std::array<Point_2, 3> face;
+    for(int i = 0; i < 3; i ++){
         CDTPoint p = f->vertex(i)->point();
-        // #pragma omp critical
-        face.push_back(Point_2{p.x(), p.y()});
+        face[i] = Point_2{p.x(), p.y()};
     }
-	return face;
+    return face;
 }
 
 /// <summary>
 /// Retrieves all the vertices of the adaptive mesh.
 /// </summary>
-/// <returns>A vector containing all vertices of the adaptive mesh.</returns>
-std::vector<Point_2> AdaptiveMesh::vertices()
+/// <returns>The vertices of the adaptive mesh, valid until the mesh is rebuilt.</returns>
+std::vector<Point_2> const &AdaptiveMesh::vertices() const
 {
-    return std::vector<Point_2>{m_vs};
+    return m_vs;
+}
+
+/// <summary>
+/// Retrieves all the triangles of the adaptive mesh that lie inside the patch.
+/// </summary>
+/// <returns>A vector containing the indices (into vertices()) of the three corners of every triangle inside the boundary.</returns>
+std::vector<std::array<int, 3>> AdaptiveMesh::triangles()
+{
+    std::vector<std::array<int, 3>> ts;
+    for(CDT::Finite_faces_iterator fit = m_cdt.finite_faces_begin(); fit != m_cdt.finite_faces_end(); fit ++){
+        // Faces outside the constrained boundary are part of the triangulation but not of the patch.
+        if(!fit -> is_in_domain()) continue;
+
+        ts.push_back({fit -> vertex(0) -> info(), fit -> vertex(1) -> info(), fit -> vertex(2) -> info()});
+    }
+    return ts;
 }
 
 /// <summary>
@@ -0,0 +1,21 @@
+#include "trace.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// Debug builds of the executables count every allocation through operator new (the array and nothrow forms end up here
+// too), so that the stages meant to run without touching the heap can be checked; see Trace::allocations(). It lives
+// outside of mvcc_core so that the library leaves the allocator of the programs embedding it alone.
+// Over-aligned allocations are not counted.
+#ifndef NDEBUG
+void *operator new(std::size_t size)
+{
+    Trace::countAllocation();
+    if (auto *p = std::malloc(size > 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+#endif
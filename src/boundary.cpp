@@ -0,0 +1,212 @@
+#include "boundary.hpp"
+
+/// <summary>
+/// The mask as a single-channel 8-bit image whose non-zero pixels are inside. 8-bit single-channel masks are returned
+/// as they are, without copying; colour masks are converted to grey, and other depths compared against zero.
+/// </summary>
+/// <param name="mask">Mask image with 1, 3 or 4 channels of any depth.</param>
+cv::Mat maskPlane(cv::Mat const &mask)
+{
+	if (mask.type() == CV_8UC1)
+		return mask;
+
+	cv::Mat plane = mask;
+	if (mask.channels() == 4)
+		cv::cvtColor(mask, plane, cv::COLOR_BGRA2GRAY);
+	else if (mask.channels() == 3)
+		cv::cvtColor(mask, plane, cv::COLOR_BGR2GRAY);
+	if (plane.depth() != CV_8U)
+		cv::compare(plane, 0, plane, cv::CMP_NE);
+	return plane;
+}
+
+/// <summary>
+/// Converts a closed contour into a boundary ring, in reverse order, dropping points while they stay within the tolerance.
+/// </summary>
+/// <param name="contour">Contour as traced by findContours.</param>
+/// <param name="tolerance">Largest distance in pixels of a dropped point to the simplified ring; 0 keeps every point.</param>
+/// <returns>The ring, or the unsimplified ring if simplifying would leave fewer than three points.</returns>
+std::vector<Point_2> simplifyRing(std::vector<cv::Point> const &contour, double tolerance)
+{
+	auto const *points = &contour;
+	std::vector<cv::Point> simplified;
+	if (tolerance > 0.0 && contour.size() > 3)
+	{
+		cv::approxPolyDP(contour, simplified, tolerance, true);
+		if (simplified.size() >= 3)
+			points = &simplified;
+	}
+
+	std::vector<Point_2> ring;
+	ring.reserve(points->size());
+	for (auto p = points->rbegin(); p != points->rend(); ++p)
+		ring.push_back(Point_2(p->x, p->y));
+	return ring;
+}
+
+/// <summary>
+/// Sign of the turn a -> b -> c. Ring points lie on the pixel grid, so the products are exact.
+/// </summary>
+static int turn(Point_2 const &a, Point_2 const &b, Point_2 const &c)
+{
+	auto const v = (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+	return (v > 0.0) - (v < 0.0);
+}
+
+/// <summary>
+/// Whether segments ab and cd cross at a point inside both. Touching is not crossing: the traced contours already touch
+/// themselves along parts of a mask one pixel wide, and the triangulation splits its constraints there.
+/// </summary>
+static bool crosses(Point_2 const &a, Point_2 const &b, Point_2 const &c, Point_2 const &d)
+{
+	return turn(a, b, c) * turn(a, b, d) < 0 && turn(c, d, a) * turn(c, d, b) < 0;
+}
+
+/// <summary>
+/// Side of a ring a point lies on.
+/// </summary>
+/// <returns>1 inside, -1 outside, 0 on the ring.</returns>
+static int side(Point_2 const &p, std::vector<Point_2> const &ring)
+{
+	bool inside = false;
+	for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+	{
+		auto const &a = ring[j];
+		auto const &b = ring[i];
+		if (turn(a, b, p) == 0 && std::min(a.x(), b.x()) <= p.x() && p.x() <= std::max(a.x(), b.x())
+			&& std::min(a.y(), b.y()) <= p.y() && p.y() <= std::max(a.y(), b.y()))
+			return 0;
+		if ((a.y() > p.y()) != (b.y() > p.y()) && p.x() < a.x() + (p.y() - a.y()) * (b.x() - a.x()) / (b.y() - a.y()))
+			inside = !inside;
+	}
+	return inside ? 1 : -1;
+}
+
+/// <summary>
+/// Side of another ring a ring lies on. The rings must not cross, so the first point that is not on the other ring
+/// decides for the whole ring.
+/// </summary>
+static int side(std::vector<Point_2> const &ring, std::vector<Point_2> const &other)
+{
+	for (auto const &p : ring)
+		if (auto const s = side(p, other); s != 0)
+			return s;
+	return 0;
+}
+
+/// <summary>
+/// Whether the rings of a component have kept the topology of its contours: no edge crosses another edge, of the same
+/// ring or of another one, every hole lies inside the outer ring, and no hole lies inside another.
+/// </summary>
+/// <param name="rings">Outer ring followed by the rings of the holes.</param>
+static bool keepsTopology(std::vector<std::vector<Point_2>> const &rings)
+{
+	struct Edge
+	{
+		Point_2 a, b;
+		double left, right;
+	};
+	std::vector<Edge> edges;
+	for (auto const &ring : rings)
+	{
+		for (size_t i = 0; i < ring.size(); ++i)
+		{
+			auto const &a = ring[i];
+			auto const &b = ring[(i + 1) % ring.size()];
+			edges.push_back({a, b, std::min(a.x(), b.x()), std::max(a.x(), b.x())});
+		}
+	}
+
+	// Sweep along x: only edges whose x ranges overlap can cross.
+	std::sort(edges.begin(), edges.end(), [](auto const &e, auto const &f){ return e.left < f.left; });
+	for (size_t i = 0; i < edges.size(); ++i)
+		for (size_t j = i + 1; j < edges.size() && edges[j].left <= edges[i].right; ++j)
+			if (crosses(edges[i].a, edges[i].b, edges[j].a, edges[j].b))
+				return false;
+
+	for (size_t h = 1; h < rings.size(); ++h)
+	{
+		if (side(rings[h], rings[0]) < 0)
+			return false;
+		for (size_t k = 1; k < rings.size(); ++k)
+			if (k != h && side(rings[h], rings[k]) > 0)
+				return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// Rings of one mask component, see getBoundaries.
+/// </summary>
+/// <returns>The outer ring followed by the rings of the holes, which run opposite to it.</returns>
+static std::vector<std::vector<Point_2>> componentRings(std::vector<std::vector<cv::Point>> const &contours, std::vector<cv::Vec4i> const &hierarchy, int outer, double tolerance)
+{
+	std::vector<std::vector<Point_2>> rings {simplifyRing(contours[outer], tolerance)};
+	auto const area = signedArea(rings.front());
+	for (auto h = hierarchy[outer][2]; h >= 0; h = hierarchy[h][0])
+	{
+		// Holes of a single pixel row or column enclose no area and cannot be meshed around.
+		auto hole = simplifyRing(contours[h], tolerance);
+		auto const holeArea = signedArea(hole);
+		if (hole.size() < 3 || holeArea == 0.0)
+			continue;
+		if ((holeArea > 0.0) == (area > 0.0))
+			std::reverse(hole.begin(), hole.end());
+		rings.push_back(std::move(hole));
+	}
+	return rings;
+}
+
+/// <summary>
+/// Extracts the boundaries of every connected component of a mask, with the contours of their holes.
+/// </summary>
+/// <param name="mask">Mask image; non-zero pixels are inside.</param>
+/// <param name="tolerance">Simplification tolerance in pixels, see simplifyRing; 0 keeps every boundary pixel.</param>
+/// <returns>One boundary per component, largest first.</returns>
+std::vector<Boundary> getBoundaries(cv::Mat const &mask, double tolerance)
+{
+	auto const plane = maskPlane(mask);
+	auto const bbox = cv::boundingRect(plane);
+	if (bbox.width <= 0 || bbox.height <= 0)
+		return {};
+
+	// Two levels: outer contours, and for each of them the contours of its holes. Points are in mask coordinates.
+	std::vector<std::vector<cv::Point> > contours;
+	std::vector<cv::Vec4i> hierarchy;
+	cv::findContours(plane(bbox), contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_NONE, bbox.tl());
+
+	std::vector<Boundary> boundaries;
+	for (int i = 0; i < static_cast<int>(contours.size()); ++i)
+	{
+		// Holes are visited through the outer contour that contains them.
+		if (hierarchy[i][3] >= 0)
+			continue;
+
+		// Rings are simplified one by one, so a simplified ring may cross itself or another ring, or a hole may end up
+		// outside the outer ring, and the triangulation would then fail. The tolerance is halved until the rings keep
+		// the topology of the contours, down to the contours as traced.
+		auto rings = componentRings(contours, hierarchy, i, tolerance);
+		for (auto t = tolerance; t > 0.0 && !keepsTopology(rings);)
+		{
+			t = t / 2.0 < 0.5 ? 0.0 : t / 2.0;
+			rings = componentRings(contours, hierarchy, i, t);
+		}
+
+		Boundary boundary(rings.front());
+		for (size_t h = 1; h < rings.size(); ++h)
+			boundary.addRing(rings[h]);
+		boundaries.push_back(std::move(boundary));
+	}
+
+	std::stable_sort(boundaries.begin(), boundaries.end(), [](auto const &a, auto const &b){ return a.size() > b.size(); });
+	return boundaries;
+}
+
+/// <summary>
+/// Boundary of the largest component of a mask.
+/// </summary>
+Boundary getBoundary(cv::Mat const &mask, double tolerance)
+{
+	auto boundaries = getBoundaries(mask, tolerance);
+	return boundaries.empty() ? Boundary{} : std::move(boundaries.front());
+}
@@ -0,0 +1,122 @@
+#include "image_io.hpp"
+#include "trace.hpp"
+
+/// <summary>
+/// The path with its extension replaced by the output format, if one is set.
+/// </summary>
+std::filesystem::path ImageWriteOptions::path(std::filesystem::path const &path) const
+{
+    if (format.empty())
+        return path;
+    auto result = path;
+    return result.replace_extension(format);
+}
+
+/// <summary>
+/// Encoder parameters for cv::imwrite; each encoder ignores the parameters of the others.
+/// </summary>
+std::vector<int> ImageWriteOptions::params() const
+{
+    return {cv::IMWRITE_PNG_COMPRESSION, pngCompression, cv::IMWRITE_JPEG_QUALITY, jpegQuality};
+}
+
+/// <summary>
+/// cv::imread, traced as an I/O stage.
+/// </summary>
+cv::Mat readImage(std::string const &path, int flags)
+{
+    TRACE_SCOPE("io.read");
+    return cv::imread(path, flags);
+}
+
+/// <summary>
+/// cv::imwrite with the output format and compression settings, traced as an I/O stage.
+/// </summary>
+/// <returns>Whether the image was written; false also when OpenCV has no encoder for the format or the image type.</returns>
+bool writeImage(std::string const &path, cv::Mat const &image, ImageWriteOptions const &options)
+{
+    TRACE_SCOPE("io.write");
+    try
+    {
+        return cv::imwrite(options.path(path).string(), image, options.params());
+    }
+    catch (cv::Exception const &e)
+    {
+        std::cerr << e.what() << "\n";
+        return false;
+    }
+}
+
+/// <summary>
+/// Starts the reader and encoder threads.
+/// </summary>
+/// <param name="options">Output format and compression settings of every write.</param>
+/// <param name="threads">Number of reader threads, and of encoder threads.</param>
+/// <param name="queueDepth">Number of requests that may wait for a reader, and for an encoder.</param>
+ImageIO::ImageIO(ImageWriteOptions const &options, int threads, size_t queueDepth)
+    : m_options(options), m_reads(queueDepth), m_writes(queueDepth)
+{
+    auto const worker = [](BoundedQueue<std::function<void()>> &queue)
+    {
+        return [&queue]
+        {
+            while (auto task = queue.pop())
+                (*task)();
+        };
+    };
+    for (int i = 0; i < std::max(threads, 1); ++i)
+    {
+        m_readers.emplace_back(worker(m_reads));
+        m_writers.emplace_back(worker(m_writes));
+    }
+}
+
+ImageIO::~ImageIO()
+{
+    finish();
+}
+
+/// <summary>
+/// Queues the decoding of an image.
+/// </summary>
+/// <returns>The image once a reader has decoded it; empty if it could not be read.</returns>
+std::shared_future<cv::Mat> ImageIO::read(std::string const &path, int flags)
+{
+    auto task = std::make_shared<std::packaged_task<cv::Mat()>>([path, flags]{ return readImage(path, flags); });
+    auto image = task->get_future().share();
+    m_reads.push([task]{ (*task)(); });
+    return image;
+}
+
+/// <summary>
+/// Queues the encoding of an image. The image is shared, not copied, so the caller must not modify its pixels afterwards.
+/// </summary>
+void ImageIO::write(std::string const &path, cv::Mat image)
+{
+    m_writes.push([this, path, image = std::move(image)]
+    {
+        if (!writeImage(path, image, m_options))
+        {
+            ++m_failed;
+            std::cerr << "Could not write " << m_options.path(path).string() << "\n";
+        }
+    });
+}
+
+/// <summary>
+/// Waits until every queued read and write is done and stops the threads. No requests may be made afterwards.
+/// </summary>
+/// <returns>The number of images that could not be written.</returns>
+size_t ImageIO::finish()
+{
+    m_reads.close();
+    m_writes.close();
+    for (auto *threads : {&m_readers, &m_writers})
+    {
+        for (auto &thread : *threads)
+            if (thread.joinable())
+                thread.join();
+        threads->clear();
+    }
+    return m_failed;
+}
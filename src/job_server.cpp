@@ -0,0 +1,244 @@
+#include "job_server.hpp"
+
+#include <sstream>
+#include <opencv2/imgcodecs.hpp>
+
+/// <summary>
+/// Parses a flat JSON object. String values are unescaped; numbers, arrays and literals are returned as their raw text.
+/// </summary>
+/// <param name="line">A single JSON object.</param>
+/// <returns>The members of the object.</returns>
+std::map<std::string, std::string> parseJsonObject(std::string const &line)
+{
+    size_t i = 0;
+    auto skip = [&]{ while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))) ++i; };
+    auto expect = [&](char c)
+    {
+        skip();
+        if (i >= line.size() || line[i] != c)
+            throw std::runtime_error(std::string("expected '") + c + "' at offset " + std::to_string(i));
+        ++i;
+    };
+    auto string = [&]
+    {
+        expect('"');
+        std::string s;
+        while (i < line.size() && line[i] != '"')
+        {
+            auto c = line[i++];
+            if (c == '\\' && i < line.size())
+            {
+                switch (auto const e = line[i++])
+                {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u':
+                        // Paths are expected to be ASCII; other code points are rejected.
+                        if (i + 4 > line.size() || std::stoi(line.substr(i, 4), nullptr, 16) > 0x7f)
+                            throw std::runtime_error("unsupported \\u escape");
+                        c = static_cast<char>(std::stoi(line.substr(i, 4), nullptr, 16));
+                        i += 4;
+                        break;
+                    default: c = e; break;
+                }
+            }
+            s.push_back(c);
+        }
+        expect('"');
+        return s;
+    };
+
+    std::map<std::string, std::string> members;
+    expect('{');
+    skip();
+    if (i < line.size() && line[i] == '}')
+        return members;
+    for (;;)
+    {
+        auto const key = string();
+        expect(':');
+        skip();
+        if (i < line.size() && line[i] == '"')
+        {
+            members[key] = string();
+        }
+        else
+        {
+            // Raw value up to the next member; nested arrays are kept whole.
+            auto const begin = i;
+            auto depth = 0;
+            while (i < line.size() && (depth > 0 || (line[i] != ',' && line[i] != '}')))
+            {
+                if (line[i] == '[') ++depth;
+                if (line[i] == ']') --depth;
+                ++i;
+            }
+            auto value = line.substr(begin, i - begin);
+            value.erase(value.find_last_not_of(" \t\r\n") + 1);
+            members[key] = value;
+        }
+        skip();
+        if (i < line.size() && line[i] == ',')
+        {
+            ++i;
+            continue;
+        }
+        expect('}');
+        return members;
+    }
+}
+
+static std::string jsonString(std::string const &s)
+{
+    std::string out = "\"";
+    for (auto c : s)
+    {
+        if (c == '"' || c == '\\') out += '\\';
+        if (c == '\n') { out += "\\n"; continue; }
+        out += c;
+    }
+    return out + "\"";
+}
+
+/// <summary>
+/// Creates a server. The memory budget is split evenly between decoded images and plans.
+/// </summary>
+JobServer::JobServer(MVCSolver const &solver, ServerOptions const &options)
+    : m_solver(solver), m_options(options), m_images(options.memoryBudget / 2), m_plans(options.memoryBudget / 2)
+{
+}
+
+/// <summary>
+/// Reads jobs from a stream until it ends and answers each of them on the output stream. Jobs run on a pool of worker
+/// threads, which share the OpenMP threads between them.
+/// </summary>
+/// <param name="in">Stream of JSON-lines jobs.</param>
+/// <param name="out">Stream of JSON-lines answers.</param>
+void JobServer::serve(std::istream &in, std::ostream &out)
+{
+    auto const workers = std::max(1, m_options.workers);
+    BoundedQueue<std::string> jobs(static_cast<size_t>(workers) * 4);
+
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; ++w)
+    {
+        pool.emplace_back([&]
+        {
+#ifdef _OPENMP
+            omp_set_num_threads(std::max(1, omp_get_num_procs() / workers));
+#endif
+            while (auto line = jobs.pop())
+            {
+                auto const answer = run(*line);
+                std::lock_guard lock(m_output);
+                out << answer << std::endl;
+            }
+        });
+    }
+
+    for (std::string line; std::getline(in, line);)
+        if (line.find_first_not_of(" \t\r") != std::string::npos)
+            jobs.push(line);
+    jobs.close();
+
+    for (auto &worker : pool)
+        worker.join();
+
+    std::cerr << "images: " << m_images.hits() << " hits, " << m_images.misses() << " misses, " << m_images.bytes() / (1 << 20) << " MB; "
+              << "plans: " << m_plans.hits() << " hits, " << m_plans.misses() << " misses, " << m_plans.bytes() / (1 << 20) << " MB\n";
+}
+
+/// <summary>
+/// Runs a single job.
+/// </summary>
+/// <param name="line">The job as a JSON object.</param>
+/// <returns>The answer as a JSON object.</returns>
+std::string JobServer::run(std::string const &line)
+{
+    TRACE_SCOPE("job");
+    auto const start = std::chrono::steady_clock::now();
+    std::string id;
+    try
+    {
+        auto const job = parseJsonObject(line);
+        auto const field = [&job](std::string const &name)
+        {
+            auto const it = job.find(name);
+            if (it == job.end())
+                throw std::runtime_error("missing field \"" + name + "\"");
+            return it->second;
+        };
+        if (job.count("id"))
+            id = job.at("id");
+
+        glm::vec2 offset {0, 0};
+        if (job.count("offset") && std::sscanf(job.at("offset").c_str(), " [ %f , %f ]", &offset.x, &offset.y) != 2)
+            throw std::runtime_error("offset must be [x, y]");
+
+        auto const src = image(field("src"));
+        auto const mask = image(field("mask"));
+        auto const dest = image(field("trgt"));
+        MVCSolver::checkPlacement(src->size(), *mask, dest->size(), offset);
+        auto const plans = this->plans(field("mask"), *mask);
+        auto const result = m_solver.solve(*plans, *src, *mask, {{*dest, offset}}).front();
+
+        std::filesystem::path path = field("out");
+        if (path.is_relative())
+            path = outDirPath / "results" / path;
+        TRACE_SCOPE("io.write");
+        if (!cv::imwrite(path.string(), result))
+            throw std::runtime_error("could not write " + path.string());
+
+        auto const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::ostringstream answer;
+        answer << "{\"id\": " << jsonString(id) << ", \"status\": \"ok\", \"out\": " << jsonString(path.string()) << ", \"ms\": " << ms << "}";
+        return answer.str();
+    }
+    catch (std::exception const &e)
+    {
+        return "{\"id\": " + jsonString(id) + ", \"status\": \"error\", \"message\": " + jsonString(e.what()) + "}";
+    }
+}
+
+/// <summary>
+/// Decoded image of a file, from the image cache. Entries are keyed by path and modification time, so an image that
+/// changed on disk is decoded again.
+/// </summary>
+std::shared_ptr<cv::Mat const> JobServer::image(std::string const &path)
+{
+    std::error_code error;
+    auto const time = std::filesystem::last_write_time(path, error);
+    if (error)
+        throw std::runtime_error("could not read " + path);
+
+    auto const key = path + "@" + std::to_string(time.time_since_epoch().count());
+    return m_images.getOrLoad(key, [&]
+    {
+        TRACE_SCOPE("io.read");
+        // Targets and sources keep their bit depth; masks of any depth are accepted by the solver.
+        auto img = cv::imread(path, cv::IMREAD_COLOR | cv::IMREAD_ANYDEPTH);
+        if (img.empty())
+            throw std::runtime_error("could not decode " + path);
+        return img;
+    }, [](cv::Mat const &img){ return img.total() * img.elemSize(); });
+}
+
+/// <summary>
+/// Plans of all components of a mask, from the plan cache (and, below it, the on-disk cache of the solver if it has one).
+/// </summary>
+std::shared_ptr<std::vector<MVCPlan> const> JobServer::plans(std::string const &maskPath, cv::Mat const &mask)
+{
+    std::error_code error;
+    auto const time = std::filesystem::last_write_time(maskPath, error);
+    auto const key = maskPath + "@" + std::to_string(time.time_since_epoch().count());
+    return m_plans.getOrLoad(key, [&]{ return m_solver.plans(mask); }, [](std::vector<MVCPlan> const &plans)
+    {
+        size_t bytes = 0;
+        for (auto const &plan : plans)
+            bytes += plan.bytes();
+        return bytes;
+    });
+}
@@ -0,0 +1,289 @@
+#include "live_preview.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+
+using Position = std::pair<double, double>;
+
+static Position position(Point_2 const &p)
+{
+    return {p.x(), p.y()};
+}
+
+/// <summary>
+/// Share of the mean-value weight of a vertex that the boundary points added by an edit take. Their weights are computed
+/// as in MVCSolver::mvcHierarchical and compared with the unnormalized total of the previous coordinates of the vertex,
+/// which the largest of them gives back from its normalized value. Absolute weights are summed, so the share is an upper
+/// bound where the boundary is concave.
+/// </summary>
+/// <param name="x">Position of the vertex.</param>
+/// <param name="old">Previous boundary.</param>
+/// <param name="row">Previous coordinates of the vertex, in boundary order.</param>
+/// <param name="lost">Share of the previous coordinates that was on removed points.</param>
+/// <param name="boundary">New boundary.</param>
+/// <param name="added">Points of the new boundary that the previous one did not have.</param>
+static double addedShare(glm::dvec2 const &x, Boundary const &old, std::span<BoundaryWeight const> row, double lost, Boundary const &boundary, std::vector<int> const &added)
+{
+    if (added.empty() || row.size() < 3)
+        return 0.0;
+
+    auto const point = [](Boundary const &b, int i){ return glm::dvec2(b[i].x(), b[i].y()); };
+    auto const weight = [&x](glm::dvec2 const &prev, glm::dvec2 const &p, glm::dvec2 const &next)
+    {
+        auto const v = p - x;
+        return std::abs(halfAngleTan(prev - x, v) + halfAngleTan(v, next - x)) / glm::length(v);
+    };
+
+    // The samples of a ring are consecutive in the row; the largest weight is taken with its neighbours among them.
+    auto const k = static_cast<size_t>(std::max_element(row.begin(), row.end(), [](auto const &a, auto const &b){ return a.weight < b.weight; }) - row.begin());
+    auto const ring = old.ringOf(row[k].index);
+    auto first = k, last = k;
+    while (first > 0 && old.ringOf(row[first - 1].index) == ring)
+        --first;
+    while (last + 1 < row.size() && old.ringOf(row[last + 1].index) == ring)
+        ++last;
+    auto const prev = k == first ? last : k - 1;
+    auto const next = k == last ? first : k + 1;
+    auto const total = weight(point(old, row[prev].index), point(old, row[k].index), point(old, row[next].index)) / row[k].weight;
+    if (!(total > 0.0))
+        return 1.0;
+
+    auto gained = 0.0;
+    for (auto const i : added)
+    {
+        auto const p = point(boundary, i);
+        if (glm::distance(p, x) < 1e-4)
+            return 1.0;
+        gained += weight(point(boundary, boundary.prev(i)), p, point(boundary, boundary.next(i)));
+    }
+    return gained / ((1.0 - lost) * total + gained);
+}
+
+/// <summary>
+/// Creates a preview of an empty mask, which shows the target as it is.
+/// </summary>
+/// <param name="solver">Solver whose precision is used.</param>
+/// <param name="src">Source image.</param>
+/// <param name="dest">Target image, of the type of the source.</param>
+/// <param name="offset">Position offset of the mask inside the target image space.</param>
+/// <param name="tolerance">Largest change (sum of absolute differences) of the coordinates of a vertex that is ignored.</param>
+/// <param name="epsilon">Accuracy of the hierarchical sampling, see SamplingOptions.</param>
+LivePreview::LivePreview(MVCSolver const &solver, cv::Mat const &src, cv::Mat const &dest, glm::vec2 const &offset, double tolerance, double epsilon)
+    : m_solver(solver), m_src(src), m_dest(dest), m_offset(offset), m_sampling{Sampling::Hierarchical, epsilon}, m_tolerance(tolerance)
+{
+    reset();
+}
+
+/// <summary>
+/// Forgets all meshes and coordinates, e.g. after the mask was cleared.
+/// </summary>
+void LivePreview::reset()
+{
+    m_meshes.clear();
+    m_plans.clear();
+    m_result = m_dest.clone();
+}
+
+/// <summary>
+/// Updates the clone after the mask changed inside a rectangle.
+/// Every component of the new mask continues the previous component that owns most of its unchanged boundary points. Its
+/// mesh is updated around the change, and a vertex that kept its position keeps its coordinates, as long as the boundary
+/// points that were removed, together with the points that were added, carry at most half the tolerance of its weight:
+/// the edit can change its coordinates by about twice that. Other vertices, and the vertices of new components, are
+/// computed again. The clone is only rendered again while the mask fits inside the target at the offset.
+/// </summary>
+/// <param name="mask">The edited mask.</param>
+/// <param name="dirty">Rectangle outside of which the mask did not change, e.g. the bounding box of a brush stroke.</param>
+/// <returns>Time taken and the number of reused and recomputed vertices.</returns>
+PreviewStats LivePreview::update(cv::Mat const &mask, cv::Rect const &dirty)
+{
+    TRACE_SCOPE("preview");
+    auto const start = std::chrono::steady_clock::now();
+    PreviewStats stats;
+
+    // Whether a contour pixel belongs to the boundary depends on its neighbours, and its weight on the next and previous points.
+    auto const changed = cv::Rect(dirty.x - 2, dirty.y - 2, dirty.width + 4, dirty.height + 4);
+    auto const unchanged = [&changed](Point_2 const &p)
+    {
+        return p.x() < changed.x || p.x() >= changed.x + changed.width || p.y() < changed.y || p.y() >= changed.y + changed.height;
+    };
+
+    // Component and index of every unchanged boundary point of the previous update.
+    std::map<Position, std::pair<int, int>> previous;
+    for (int c = 0; c < static_cast<int>(m_plans.size()); ++c)
+        for (int i = 0; i < static_cast<int>(m_plans[c].boundary.size()); ++i)
+            if (unchanged(m_plans[c].boundary[i]))
+                previous[position(m_plans[c].boundary[i])] = {c, i};
+
+    auto const boundaries = getBoundaries(mask);
+    std::vector<std::unique_ptr<AdaptiveMesh>> meshes;
+    std::vector<MVCPlan> plans;
+    std::vector<char> continued(m_plans.size(), 0);
+    for (auto const &boundary : boundaries)
+    {
+        std::vector<std::pair<int, int>> matches(boundary.size(), {-1, -1});
+        std::map<int, int> votes;
+        for (size_t i = 0; i < boundary.size(); ++i)
+        {
+            if (auto const it = previous.find(position(boundary[i])); it != previous.end())
+            {
+                matches[i] = it->second;
+                ++votes[it->second.first];
+            }
+        }
+        int from = -1, best = 0;
+        for (auto const &[c, n] : votes)
+        {
+            if (!continued[c] && n > best)
+            {
+                from = c;
+                best = n;
+            }
+        }
+
+        MVCPlan old;
+        std::unique_ptr<AdaptiveMesh> mesh;
+        if (from >= 0)
+        {
+            continued[from] = 1;
+            old = std::move(m_plans[from]);
+            mesh = std::move(m_meshes[from]);
+            mesh->updateMesh(boundary, changed);
+        }
+        else
+        {
+            mesh = std::make_unique<AdaptiveMesh>();
+            mesh->createMesh(boundary);
+        }
+
+        MVCPlan plan;
+        plan.boundary = boundary;
+        plan.sampling = m_sampling;
+        plan.vertices = mesh->vertices();
+        plan.triangles = mesh->triangles();
+
+        // Index on the new boundary of every unchanged point of the old one, and the old index of every old vertex.
+        std::vector<int> remap(old.boundary.size(), -1);
+        for (size_t i = 0; i < boundary.size(); ++i)
+            if (matches[i].first == from && from >= 0)
+                remap[matches[i].second] = static_cast<int>(i);
+        std::map<Position, int> oldVertices;
+        for (int u = 0; u < static_cast<int>(old.vertices.size()); ++u)
+            oldVertices[position(old.vertices[u])] = u;
+
+        std::vector<int> added;
+        for (int i = 0; i < static_cast<int>(boundary.size()); ++i)
+            if (matches[i].first != from)
+                added.push_back(i);
+
+        auto const arc = arcLengths(boundary);
+        std::vector<std::vector<BoundaryWeight>> ws(plan.vertices.size());
+        size_t reused = 0;
+        #pragma omp parallel for schedule(dynamic, 16) reduction(+:reused)
+        for (int v = 0; v < static_cast<int>(ws.size()); ++v)
+        {
+            if (auto const it = oldVertices.find(position(plan.vertices[v])); it != oldVertices.end())
+            {
+                auto const row = old.sparseCoordinates.row(it->second);
+                auto lost = 0.0;
+                for (auto const &bw : row)
+                    if (remap[bw.index] < 0)
+                        lost += bw.weight;
+                if (2.0 * lost <= m_tolerance
+                    && 2.0 * (lost + addedShare(glm::dvec2(plan.vertices[v].x(), plan.vertices[v].y()), old.boundary, row, lost, boundary, added)) <= m_tolerance)
+                {
+                    auto const scale = 1.0 / (1.0 - lost);
+                    for (auto const &bw : row)
+                        if (remap[bw.index] >= 0)
+                            ws[v].push_back({remap[bw.index], bw.weight * scale});
+                    ++reused;
+                    continue;
+                }
+            }
+            ws[v] = m_solver.mvcHierarchical(plan.vertices[v], boundary, arc, m_sampling.epsilon);
+        }
+
+        for (auto const &w : ws)
+        {
+            plan.sparseCoordinates.weights.insert(plan.sparseCoordinates.weights.end(), w.begin(), w.end());
+            plan.sparseCoordinates.rows.push_back(static_cast<int64_t>(plan.sparseCoordinates.weights.size()));
+        }
+        stats.reused += reused;
+        stats.recomputed += ws.size() - reused;
+
+        meshes.push_back(std::move(mesh));
+        plans.push_back(std::move(plan));
+    }
+
+    m_meshes = std::move(meshes);
+    m_plans = std::move(plans);
+    if (m_plans.empty())
+        m_result = m_dest.clone();
+    else
+    {
+        // A stroke near the edge of the source can move the boundary outside of the target at the offset; the previous
+        // result is then kept until the mask fits again.
+        try
+        {
+            MVCSolver::checkPlacement(m_src.size(), mask, m_dest.size(), m_offset);
+            m_result = m_solver.solve(m_plans, m_src, mask, {{m_dest, m_offset}}).front();
+        }
+        catch (std::invalid_argument const &)
+        {
+        }
+    }
+
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+/// <summary>
+/// Builds the plans of the mask and renders the patch at its first placement.
+/// </summary>
+/// <param name="solver">Solver whose sampling, precision and plan cache are used.</param>
+/// <param name="src">Source image.</param>
+/// <param name="mask">Masked region of the source that is placed.</param>
+/// <param name="dest">Target image, of the type of the source.</param>
+/// <param name="offset">First position offset of the mask inside the target image space.</param>
+PlacementPreview::PlacementPreview(MVCSolver const &solver, cv::Mat const &src, cv::Mat const &mask, cv::Mat const &dest, cv::Point const &offset)
+    : m_solver(solver), m_src(src), m_dest(dest), m_region(mask), m_plans(solver.plans(mask)), m_frame(dest.clone())
+{
+    auto const bbox = m_region.bbox();
+    if (bbox.width > dest.cols || bbox.height > dest.rows)
+        throw std::invalid_argument("the mask does not fit inside the target");
+    m_min = {-bbox.x, -bbox.y};
+    m_max = {dest.cols - bbox.x - bbox.width, dest.rows - bbox.y - bbox.height};
+
+    m_offset = {std::clamp(offset.x, m_min.x, m_max.x), std::clamp(offset.y, m_min.y, m_max.y)};
+    m_placed = m_solver.render(m_plans, m_src, m_region, m_dest, m_frame, m_offset);
+}
+
+/// <summary>
+/// Moves the patch. The offset is clamped so that the whole mask stays inside the target, since the boundary differences
+/// are taken from the target pixels under the boundary.
+/// </summary>
+/// <param name="offset">New position offset of the mask inside the target image space.</param>
+/// <returns>Rectangles of the frame that changed: the previous and the new placement, none if the patch did not move.</returns>
+std::vector<cv::Rect> PlacementPreview::moveTo(cv::Point const &offset)
+{
+    auto const clamped = cv::Point(std::clamp(offset.x, m_min.x, m_max.x), std::clamp(offset.y, m_min.y, m_max.y));
+    if (clamped == m_offset)
+        return {};
+
+    TRACE_SCOPE("preview.move");
+    // Restore the masked pixels of the previous placement; the rest of its rectangle was never written.
+    auto const previous = m_offset;
+    m_region.forEachSpan([&](int y, int begin, int end)
+    {
+        auto const size = static_cast<size_t>(end - begin) * m_frame.elemSize();
+        std::memcpy(m_frame.ptr(y + previous.y) + (begin + previous.x) * m_frame.elemSize(), m_dest.ptr(y + previous.y) + (begin + previous.x) * m_dest.elemSize(), size);
+    });
+
+    std::vector<cv::Rect> dirty {m_placed};
+    m_offset = clamped;
+    m_placed = m_solver.render(m_plans, m_src, m_region, m_dest, m_frame, m_offset);
+    dirty.push_back(m_placed);
+    return dirty;
+}
@@ -1,13 +1,36 @@
 #include "mvc_solver.hpp"
+#include "image_io.hpp"
+#include "job_server.hpp"
 #include "mask_painter.hpp"
+#include "patch_placer.hpp"
+#include "video_pipeline.hpp"
 #include <boost/program_options.hpp>
+#include <opencv2/highgui.hpp>
+#include <map>
+#include <sstream>
 
 namespace po = boost::program_options;
 
+/// <summary>
+/// Source and target images keep their bit depth (16-bit PNG/TIFF, float EXR/HDR); masks and the frames of a video are
+/// read as 8-bit images.
+/// </summary>
+static constexpr int plateFlags = cv::IMREAD_COLOR | cv::IMREAD_ANYDEPTH;
+
 int main(int argc, const char* argv[])
 {   
     bool noInput = false;
+    bool rebuild = false;
+    bool serve = false;
+    bool place = false;
+    ServerOptions serverOptions;
+    ImageWriteOptions writeOptions;
+    int ioThreads = 2;
+    size_t memoryMB = serverOptions.memoryBudget >> 20;
     std::string resultName;
+    std::string cacheDir;
+    std::string tracePath;
+    std::string traceFormat;
     std::vector<int> offset {0, 0};
     
     po::options_description desc("Allowed options");
@@ -18,8 +41,33 @@ int main(int argc, const char* argv[])
         ("mask,m", po::value<std::string>(), "mask image path. if not specified a drawing window will appear")
         ("name,n", po::value<std::string>(&resultName)->default_value("output.png"), "name of output file")
         ("offset,o", po::value<std::vector<int>>(&offset), "Offset of patch")
+        ("place", po::bool_switch(&place), "drag the patch over the target in a window before saving; --offset is the starting position")
+        ("progressive", po::value<int>(), "solve on a pyramid from this level (downsampled by 2^level) up to the full resolution, printing when every level is ready")
         ("noInput,ni", po::bool_switch(&noInput), "uses inputs given in data folder (--i field required)")
-        ("i,i", po::value<int>()->default_value(0), "number of inputs in data folder (--noInput field required)");
+        ("i,i", po::value<int>()->default_value(0), "number of inputs in data folder (--noInput field required)")
+        ("cache,c", po::value<std::string>(&cacheDir), "directory in which meshes and mean-value coordinates are cached across runs")
+        ("rebuild", po::bool_switch(&rebuild), "recompute and overwrite cached meshes and coordinates (--cache field required)")
+        ("hierarchical", po::value<double>(), "sample the boundary hierarchically; the value trades accuracy (smaller) for speed (larger), e.g. 0.5")
+        ("mesher", po::value<std::string>()->default_value("cgal"), "'cgal' (Delaunay refinement) or 'quadtree' (graded quadtree, faster for long boundaries) mesh of the mask")
+        ("simplify", po::value<double>()->default_value(0.0), "simplify the mask boundary, dropping points that lie within this many pixels of the simplified outline (cgal mesher only)")
+        ("weights", po::value<std::string>()->default_value("double"), "storage of the mean-value coordinates kept in memory: 'double', 'float', 'half', 'bfloat16', 'int16' or 'int8'")
+        ("dropBelow", po::value<double>()->default_value(0.0), "drop coordinates smaller than this fraction of the largest one of their mesh vertex, e.g. 1e-4")
+        ("precision", po::value<std::string>()->default_value("double"), "'float' or 'double' arithmetic for the interpolation and the final intensities")
+        ("jobs,j", po::value<std::string>(), "file listing one target per line as '<target path> <offset x> <offset y>'; clones the source into all of them (--src and --mask fields required)")
+        ("patches,p", po::value<std::string>(), "file listing one patch per line as '<source path> <mask path> <offset x> <offset y>'; clones all of them into the target, later lines on top (--trgt field required)")
+        ("video,v", po::value<std::string>(), "video file or image sequence pattern (e.g. frames/%04d.png) to clone the source into, frame by frame (--src and --mask fields required)")
+        ("serve", po::bool_switch(&serve), "run as a server: read JSON-lines jobs from stdin and answer each on stdout (see job_server.hpp)")
+        ("workers", po::value<int>(&serverOptions.workers)->default_value(serverOptions.workers), "number of jobs run concurrently (--serve field required)")
+        ("memory", po::value<size_t>(&memoryMB)->default_value(memoryMB), "memory budget in MB for cached images and plans (--serve field required)")
+        ("tiles", po::value<std::string>(), "tile store to clone into in place, touching only the tiles under the patch; if -t is given the store is first created from it (--src and --mask fields required)")
+        ("tileSize", po::value<int>()->default_value(256), "width and height in pixels of the tiles of a new tile store (--tiles field required)")
+        ("format", po::value<std::string>(&writeOptions.format), "file format of the results by extension, e.g. 'png', 'jpg' or 'tiff', replacing the one of --name")
+        ("pngCompression", po::value<int>(&writeOptions.pngCompression)->default_value(writeOptions.pngCompression), "zlib level of PNG results, from 0 (fastest) to 9 (smallest)")
+        ("jpegQuality", po::value<int>(&writeOptions.jpegQuality)->default_value(writeOptions.jpegQuality), "quality of JPEG results, from 0 to 100")
+        ("ioThreads", po::value<int>(&ioThreads)->default_value(ioThreads), "number of threads reading, and of threads writing, images in the background for --noInput and --jobs")
+        ("fourcc", po::value<std::string>()->default_value("mp4v"), "codec of the output video; image sequences (--name containing %) ignore it (--video field required)")
+        ("trace", po::value<std::string>(&tracePath), "write per-stage wall and CPU times, counters and peak memory to this file when the run ends")
+        ("traceFormat", po::value<std::string>(&traceFormat)->default_value("summary"), "'summary' (JSON totals per stage) or 'chrome' (trace-event file for chrome://tracing) (--trace field required)");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -31,57 +79,405 @@ int main(int argc, const char* argv[])
     
     po::notify(vm);
 
+    static std::map<std::string, TraceFormat> const traceFormats {{"summary", TraceFormat::Summary}, {"chrome", TraceFormat::Chrome}};
+    auto const format = traceFormats.find(traceFormat);
+    if (format == traceFormats.end())
+    {
+        std::cout << "Unknown --traceFormat. Use --help,-h to check available commands\n";
+        return 1;
+    }
+
+    if (!writeOptions.format.empty() && !cv::haveImageWriter("result." + writeOptions.format))
+    {
+        std::cout << "No encoder for --format " << writeOptions.format << ". Use --help,-h to check available commands\n";
+        return 1;
+    }
+
+    // Written when main returns, whichever mode ran.
+    std::optional<TraceFile> trace;
+    if (!tracePath.empty())
+        trace.emplace(tracePath, format->second);
+
+    static std::map<std::string, MeshBackend> const meshers {{"cgal", MeshBackend::CGAL}, {"quadtree", MeshBackend::Quadtree}};
+    auto const mesher = meshers.find(vm["mesher"].as<std::string>());
+    if (mesher == meshers.end())
+    {
+        std::cout << "Unknown --mesher. Use --help,-h to check available commands\n";
+        return 1;
+    }
+
+    // The quadtree mesher relies on boundary points being neighbouring pixels.
+    if (vm["simplify"].as<double>() > 0.0 && mesher->second == MeshBackend::Quadtree)
+    {
+        std::cout << "--simplify cannot be combined with --mesher quadtree. Use --help,-h to check available commands\n";
+        return 1;
+    }
+
+    static std::map<std::string, WeightFormat> const weightFormats {{"double", WeightFormat::Double}, {"float", WeightFormat::Float},
+        {"half", WeightFormat::Half}, {"bfloat16", WeightFormat::BFloat16}, {"int16", WeightFormat::Int16}, {"int8", WeightFormat::Int8}};
+    auto const weights = weightFormats.find(vm["weights"].as<std::string>());
+    if (weights == weightFormats.end())
+    {
+        std::cout << "Unknown --weights format. Use --help,-h to check available commands\n";
+        return 1;
+    }
+    CompressionOptions const compression {weights->second, vm["dropBelow"].as<double>()};
+
+    static std::map<std::string, Precision> const precisions {{"float", Precision::Single}, {"double", Precision::Double}};
+    auto const precision = precisions.find(vm["precision"].as<std::string>());
+    if (precision == precisions.end())
+    {
+        std::cout << "Unknown --precision. Use --help,-h to check available commands\n";
+        return 1;
+    }
+
+    // Solvers share the plan cache when a cache directory is given.
+    SamplingOptions sampling;
+    if (vm.count("hierarchical"))
+        sampling = SamplingOptions{Sampling::Hierarchical, vm["hierarchical"].as<double>()};
+    auto makeSolver = [&]()
+    {
+        auto solver = cacheDir.empty() ? MVCSolver{} : MVCSolver{PlanCache{cacheDir, rebuild}};
+        solver.setSampling(sampling);
+        solver.setPrecision(precision->second);
+        solver.setMesher(mesher->second);
+        solver.setBoundaryTolerance(vm["simplify"].as<double>());
+        if (compression.format != WeightFormat::Double || compression.threshold > 0.0)
+            solver.setCompression(compression);
+        return solver;
+    };
+
+    if (serve)
+    {
+        auto const solver = makeSolver();
+        serverOptions.memoryBudget = memoryMB << 20;
+        JobServer(solver, serverOptions).serve(std::cin, std::cout);
+        return 0;
+    }
+
     if (noInput)
     {
-        MVCSolver solver {};
+        auto solver = makeSolver();
         std::vector<glm::vec2> offset {glm::vec2{100, 20}, glm::vec2{180,200}, glm::vec2{90,175}, glm::vec2{148,150}, glm::vec2{115, 270}};
-        for (int i = 0; i < 5 ;i++)
+        auto const count = 5;
+
+        // The inputs of the next job are decoded and the outputs of the previous ones encoded while a job is solved.
+        ImageIO io(writeOptions, ioThreads);
+        auto const inputs = [&](int i)
         {
-           
-            auto src = cv::imread(dataDirPath.string() + "/sources/" + "source_0" + std::to_string(i+1) + ".jpg");
-            auto dest = cv::imread(dataDirPath.string() + "/targets/" + "target_0" + std::to_string(i+1) + ".jpg");
-            auto mask = cv::imread(dataDirPath.string() + "/masks/" + "mask_0" + std::to_string(i+1) + ".png");
-            
+            auto const n = std::to_string(i+1);
+            return std::array{io.read(dataDirPath.string() + "/sources/" + "source_0" + n + ".jpg"),
+                              io.read(dataDirPath.string() + "/targets/" + "target_0" + n + ".jpg"),
+                              io.read(dataDirPath.string() + "/masks/" + "mask_0" + n + ".png")};
+        };
+        auto next = inputs(0);
+        for (int i = 0; i < count ;i++)
+        {
+            auto const current = next;
+            if (i + 1 < count)
+                next = inputs(i + 1);
+            auto const &src = current[0].get();
+            auto const &dest = current[1].get();
+            auto const &mask = current[2].get();
+
             auto test = solver.solve(src, dest, mask, offset[i]);
-            cv::imwrite(outDirPath.string() + "/results/output_0" + std::to_string(i+1) + ".png", test);
+            io.write(outDirPath.string() + "/results/output_0" + std::to_string(i+1) + ".png", test);
 
             auto cropped = cv::Mat(test.size(), CV_8UC3, cv::Scalar(0,0,0));
 
-            for (int y = 0; y < mask.rows; y++)
+            // Copy the masked rows of the result, skipping everything outside the mask.
+            auto const ox = static_cast<int>(offset[i].x);
+            auto const oy = static_cast<int>(offset[i].y);
+            SpanMask(mask).clip(cv::Rect(-ox, -oy, test.cols, test.rows)).forEachSpan([&](int y, int begin, int end)
             {
-                for (int x = 0; x < mask.cols; x++)
-                {
-                    if(mask.at<cv::Vec3b>(y, x)[0] != 255 ) continue;
-                    cropped.at<cv::Vec3b>(y + offset[i].y, x+ offset[i].x) = test.at<cv::Vec3b>(y + offset[i].y, x+ offset[i].x);
-                }
-            }
-            cv::imwrite(outDirPath.string() + "/results/output_cropped_0" + std::to_string(i+1) + ".png", cropped);
+                auto const *from = test.ptr<cv::Vec3b>(y + oy) + ox;
+                std::copy(from + begin, from + end, cropped.ptr<cv::Vec3b>(y + oy) + ox + begin);
+            });
+            io.write(outDirPath.string() + "/results/output_cropped_0" + std::to_string(i+1) + ".png", cropped);
 
         }
+        io.finish();
         return 1;
     }
     
+    if (vm.count("jobs"))
+    {
+        if (!vm.count("src") || !vm.count("mask"))
+        {
+            std::cout << "Please provide the -s and the -m paths together with --jobs. Use --help,-h to check available commands\n";
+            return 1;
+        }
+
+        std::vector<std::string> targets;
+        std::vector<glm::vec2> offsets;
+        std::ifstream list(vm["jobs"].as<std::string>());
+        for (std::string line; std::getline(list, line);)
+        {
+            std::istringstream fields(line);
+            std::string path;
+            glm::vec2 jobOffset;
+            if (line.empty() || line[0] == '#' || !(fields >> path >> jobOffset.x >> jobOffset.y))
+                continue;
+            targets.push_back(path);
+            offsets.push_back(jobOffset);
+        }
+
+        // Targets are decoded up to `prefetch` jobs ahead and results encoded in the background, while the jobs are
+        // solved in order with one plan; the batch takes about as long as the slower of the I/O and the solves.
+        ImageIO io(writeOptions, ioThreads);
+        auto const prefetch = static_cast<size_t>(2 * std::max(ioThreads, 1));
+        std::deque<std::shared_future<cv::Mat>> pending;
+        for (size_t i = 0; i < std::min(prefetch, targets.size()); ++i)
+            pending.push_back(io.read(targets[i], plateFlags));
+
+        auto solver = makeSolver();
+        auto src = readImage(vm["src"].as<std::string>(), plateFlags);
+        auto const plan = solver.prepare(readImage(vm["mask"].as<std::string>()));
+
+        // Results are numbered after the output name: output.png becomes output_0.png, output_1.png, ...
+        auto const name = std::filesystem::path(resultName);
+        size_t written = 0;
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            auto const dest = pending.front().get();
+            pending.pop_front();
+            if (i + prefetch < targets.size())
+                pending.push_back(io.read(targets[i + prefetch], plateFlags));
+            if (dest.empty())
+            {
+                std::cerr << "Could not read " << targets[i] << ", skipped\n";
+                continue;
+            }
+
+            // A job that does not fit its target is skipped; the rest of the batch goes on.
+            cv::Mat result;
+            try
+            {
+                MVCSolver::checkPlacement(src.size(), plan.mask(), dest.size(), offsets[i]);
+                result = solver.solve(plan, src, dest, offsets[i]);
+            }
+            catch (std::invalid_argument const &e)
+            {
+                std::cerr << targets[i] << ": " << e.what() << ", skipped\n";
+                continue;
+            }
+            io.write(outDirPath.string() + "/results/" + name.stem().string() + "_" + std::to_string(i) + name.extension().string(), result);
+            ++written;
+        }
+        auto const failed = io.finish();
+        std::cout << written - failed << " results saved to " + outDirPath.string() + "/results/" << "\n";
+        return 0;
+    }
+
+    if (vm.count("patches"))
+    {
+        if (!vm.count("trgt"))
+        {
+            std::cout << "Please provide the -t path together with --patches. Use --help,-h to check available commands\n";
+            return 1;
+        }
+
+        std::vector<std::array<std::string, 2>> paths;
+        std::vector<PatchJob> patches;
+        std::ifstream list(vm["patches"].as<std::string>());
+        for (std::string line; std::getline(list, line);)
+        {
+            std::istringstream fields(line);
+            std::string srcPath, maskPath;
+            glm::vec2 patchOffset;
+            if (line.empty() || line[0] == '#' || !(fields >> srcPath >> maskPath >> patchOffset.x >> patchOffset.y))
+                continue;
+            paths.push_back({srcPath, maskPath});
+            patches.push_back({cv::Mat{}, cv::Mat{}, patchOffset});
+        }
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(patches.size()); ++i)
+        {
+            patches[i].src = readImage(paths[i][0], plateFlags);
+            patches[i].mask = readImage(paths[i][1]);
+        }
+
+        for (size_t i = 0; i < patches.size(); ++i)
+        {
+            if (patches[i].src.empty() || patches[i].mask.empty())
+            {
+                std::cout << "Could not read " << (patches[i].src.empty() ? paths[i][0] : paths[i][1]) << "\n";
+                return 1;
+            }
+        }
+
+        auto solver = makeSolver();
+        auto dest = readImage(vm["trgt"].as<std::string>(), plateFlags);
+        if (dest.empty())
+        {
+            std::cout << "Could not read " << vm["trgt"].as<std::string>() << "\n";
+            return 1;
+        }
+
+        // A patch that does not fit the target is skipped; the other patches are still composited.
+        std::vector<PatchJob> placed;
+        for (size_t i = 0; i < patches.size(); ++i)
+        {
+            try
+            {
+                MVCSolver::checkPlacement(patches[i].src.size(), patches[i].mask, dest.size(), patches[i].offset);
+                placed.push_back(patches[i]);
+            }
+            catch (std::invalid_argument const &e)
+            {
+                std::cerr << paths[i][0] << ": " << e.what() << ", skipped\n";
+            }
+        }
+
+        auto const start = std::chrono::steady_clock::now();
+        auto const result = solver.composite(dest, placed);
+        std::cout << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << "ms\n";
+        auto const path = writeOptions.path(outDirPath / "results" / resultName).string();
+        if (!writeImage(path, result, writeOptions))
+        {
+            std::cerr << "Could not write " << path << "\n";
+            return 1;
+        }
+        std::cout << "Result saved to " + path << "\n";
+        return 0;
+    }
+
+    if (vm.count("video"))
+    {
+        if (!vm.count("src") || !vm.count("mask"))
+        {
+            std::cout << "Please provide the -s and the -m paths together with --video. Use --help,-h to check available commands\n";
+            return 1;
+        }
+
+        cv::VideoCapture input(vm["video"].as<std::string>());
+        if (!input.isOpened())
+        {
+            std::cout << "Could not open " << vm["video"].as<std::string>() << "\n";
+            return 1;
+        }
+
+        // The mask must fit every frame at the offset, since the boundary differences are read from the frames. Inputs
+        // that do not report their frame size are checked on their first frame instead, see VideoCloner::run.
+        auto src = readImage(vm["src"].as<std::string>());
+        auto mask = readImage(vm["mask"].as<std::string>());
+        cv::Size const size(static_cast<int>(input.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(input.get(cv::CAP_PROP_FRAME_HEIGHT)));
+        try
+        {
+            if (!size.empty())
+                MVCSolver::checkPlacement(src.size(), mask, size, glm::vec2{offset[0], offset[1]});
+        }
+        catch (std::invalid_argument const &e)
+        {
+            std::cout << e.what() << ". Use --help,-h to check available commands\n";
+            return 1;
+        }
+
+        // Image sequences are written with one file per frame, videos with the requested codec.
+        auto const path = outDirPath.string() + "/results/" + resultName;
+        auto const codec = vm["fourcc"].as<std::string>();
+        auto const fourcc = resultName.find('%') != std::string::npos || codec.size() != 4 ? 0 : cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]);
+        auto const fps = input.get(cv::CAP_PROP_FPS);
+        cv::VideoWriter output(path, fourcc, fps > 0.0 ? fps : 25.0, size);
+        if (!output.isOpened())
+        {
+            std::cout << "Could not open " << path << " for writing\n";
+            return 1;
+        }
+
+        auto solver = makeSolver();
+        PipelineStats stats;
+        try
+        {
+            stats = VideoCloner(solver).run(src, mask, glm::vec2{offset[0], offset[1]}, input, output);
+        }
+        catch (std::exception const &e)
+        {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        stats.print(std::cout);
+        std::cout << "Result saved to " + path << "\n";
+        return 0;
+    }
+
+    if (vm.count("tiles"))
+    {
+        if (!vm.count("src") || !vm.count("mask"))
+        {
+            std::cout << "Please provide the -s and the -m paths together with --tiles. Use --help,-h to check available commands\n";
+            return 1;
+        }
+
+        // Opening a missing or foreign store, importing an unreadable target and misplacing the mask all throw.
+        auto const path = vm["tiles"].as<std::string>();
+        try
+        {
+            auto store = vm.count("trgt") ? TileStore::import(vm["trgt"].as<std::string>(), path, vm["tileSize"].as<int>()) : TileStore(path);
+            auto solver = makeSolver();
+            auto src = readImage(vm["src"].as<std::string>(), plateFlags);
+            auto mask = readImage(vm["mask"].as<std::string>());
+            auto const written = solver.solve(src, mask, store, glm::vec2{offset[0], offset[1]});
+            std::cout << written << " tiles written to " << path << "\n";
+        }
+        catch (std::exception const &e)
+        {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
     if (vm.count("src") && vm.count("trgt")) {
-        MVCSolver solver {};
-        auto src = cv::imread(vm["src"].as<std::string>());
-        auto dest = cv::imread(vm["trgt"].as<std::string>());
+        auto solver = makeSolver();
+        auto src = readImage(vm["src"].as<std::string>(), plateFlags);
+        auto dest = readImage(vm["trgt"].as<std::string>(), plateFlags);
 
-        cv::Mat result;
+        cv::Mat mask;
         if(vm.count("mask"))
         {
-            auto mask = cv::imread(vm["mask"].as<std::string>());
-            result = solver.solve(src, dest, mask, glm::vec2{offset[0], offset[1]});
+            mask = readImage(vm["mask"].as<std::string>());
         }else
         {
             MaskPainter painter {vm["src"].as<std::string>()};
+            LivePreview preview(solver, src, dest, glm::vec2{offset[0], offset[1]});
+            painter.setPreview(&preview);
             painter.paintMask("new_mask_rename.png");
-            auto mask = cv::imread(dataDirPath.string() + "/masks/new_mask_rename.png", CV_8UC1);
+            mask = readImage(dataDirPath.string() + "/masks/new_mask_rename.png", CV_8UC1);
+        }
+
+        cv::Mat result;
+        if (place)
+        {
+            PlacementPreview preview(solver, src, mask, dest, cv::Point(offset[0], offset[1]));
+            if (!PatchPlacer{preview}.place())
+                return 0;
+            result = preview.frame().clone();
+        }else if (vm.count("progressive"))
+        {
+            auto const start = std::chrono::steady_clock::now();
+            result = solver.solveProgressive(src, dest, mask, glm::vec2{offset[0], offset[1]}, vm["progressive"].as<int>(), [&](int level, cv::Mat const &)
+            {
+                auto const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                std::cout << "Level " << level << " ready after " << ms << "ms\n";
+            }).get();
+        }else
+        {
+            auto const start = std::chrono::steady_clock::now();
             result = solver.solve(src, dest, mask, glm::vec2{offset[0], offset[1]});
+            std::cout << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << "ms\n";
         }
-        cv::imwrite(outDirPath.string() + "/results/" + resultName, result);
+        auto const path = writeOptions.path(outDirPath / "results" / resultName).string();
+        auto const saved = writeImage(path, result, writeOptions);
         cv::imshow(resultName, result);
         cv::waitKey(0);
-        std::cout << "Result saved to " + outDirPath.string() + "/results/" + resultName << "\n";
+        if (!saved)
+        {
+            std::cerr << "Could not write " << path << "\n";
+            return 1;
+        }
+        std::cout << "Result saved to " + path << "\n";
     }else{
         std::cout << "Please provide both the -s and the -t paths. Use --help,-h to check available commands\n";
         return 1; 
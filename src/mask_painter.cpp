@@ -1,5 +1,8 @@
 #include "mask_painter.hpp"
 
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
+
 MaskPainter::MaskPainter(std::string const &imagePath, std::string const &windowName)
 {
     m_imagePath = imagePath;
@@ -45,10 +48,25 @@ void MaskPainter::paintMaskHandler(int event, int x, int y)
                 contours.push_back(points);
                 cv::drawContours(m_image, contours, 0, cv::Scalar(255), -1);
                 cv::drawContours(m_mask, contours, 0, cv::Scalar(255), -1);
+                if (m_preview)
+                    showPreview(cv::boundingRect(points));
             }
             break;
     }
 }
+
+/// <summary>
+/// Updates the live preview after a stroke and shows it next to the painter.
+/// </summary>
+/// <param name="dirty">Bounding box of the stroke.</param>
+void MaskPainter::showPreview(cv::Rect const &dirty)
+{
+    cv::Mat mask;
+    m_mask.convertTo(mask, CV_8U);
+    auto const stats = m_preview->update(mask, dirty);
+    cv::imshow(m_windowName + " - preview", m_preview->result());
+    std::cout << "Preview updated in " << stats.ms << "ms: " << stats.recomputed << " vertices recomputed, " << stats.reused << " reused\n";
+}
         
 void MaskPainter::paintMask(std::string const &filename)
 {
@@ -64,6 +82,11 @@ void MaskPainter::paintMask(std::string const &filename)
         {
             m_image = m_imageCopy.clone();
             m_mask = m_maskCopy.clone();
+            if (m_preview)
+            {
+                m_preview->reset();
+                cv::imshow(m_windowName + " - preview", m_preview->result());
+            }
         }else if(key == 's')
         {
             break;
@@ -0,0 +1,196 @@
+#include "membrane.hpp"
+
+// Register tile (rows of W x right-hand sides) and boundary slice length of the dense product.
+static constexpr size_t tileRows = 4;
+static constexpr size_t tileCols = 4;
+static constexpr size_t sliceLength = 1024;
+
+/// <summary>
+/// Evaluates the membrane of k right-hand sides at every mesh vertex of a plan.
+/// </summary>
+/// <param name="plan">Plan holding dense, sparse or compressed mean-value coordinates.</param>
+/// <param name="values">Boundary values, k x B.</param>
+/// <returns>Membrane values, V x k row-major.</returns>
+std::vector<double> evaluateMembranes(MVCPlan const &plan, CoordinateMatrix const &values)
+{
+    std::vector<double> r(plan.vertices.size() * values.rows(), 0.0);
+    if (!plan.compressedCoordinates.empty())
+        compressedMembranes(plan.compressedCoordinates, values, r.data());
+    else if (plan.sampling.mode == Sampling::Hierarchical)
+        sparseMembranes(plan.sparseCoordinates, values, r.data());
+    else
+        denseMembranes(plan.coordinates, values, r.data());
+    return r;
+}
+
+/// <summary>
+/// Accumulates one register tile: up to tileRows rows of W times up to tileCols right-hand sides, over the boundary slice [begin, end).
+/// Unused rows and columns repeat the last valid one; their results are dropped.
+/// </summary>
+static void denseTile(CoordinateMatrix const &w, CoordinateMatrix const &values, size_t v0, size_t c0, size_t begin, size_t end, double *r)
+{
+    auto const V = w.rows(), k = values.rows();
+    auto const rows = std::min(tileRows, V - v0), cols = std::min(tileCols, k - c0);
+
+    std::array<double const *, tileRows> wr;
+    std::array<double const *, tileCols> dr;
+    for (size_t i = 0; i < tileRows; ++i) wr[i] = w.row(v0 + std::min(i, rows - 1));
+    for (size_t j = 0; j < tileCols; ++j) dr[j] = values.row(c0 + std::min(j, cols - 1));
+
+    double acc[tileRows * tileCols] = {};
+    #pragma omp simd reduction(+:acc[:tileRows * tileCols])
+    for (size_t b = begin; b < end; ++b)
+        for (size_t i = 0; i < tileRows; ++i)
+            for (size_t j = 0; j < tileCols; ++j)
+                acc[i * tileCols + j] += wr[i][b] * dr[j][b];
+
+    for (size_t i = 0; i < rows; ++i)
+        for (size_t j = 0; j < cols; ++j)
+            r[(v0 + i) * k + c0 + j] += acc[i * tileCols + j];
+}
+
+/// <summary>
+/// R += W * D for a dense coordinate matrix, blocked for the caches and parallelized over blocks of rows.
+/// </summary>
+/// <param name="w">Coordinate matrix, V x B.</param>
+/// <param name="values">Boundary values, k x B.</param>
+/// <param name="r">Membrane values, V x k row-major.</param>
+void denseMembranes(CoordinateMatrix const &w, CoordinateMatrix const &values, double *r)
+{
+    auto const V = w.rows(), B = w.cols(), k = values.rows();
+    if (V == 0 || k == 0) return;
+
+    auto const blocks = static_cast<long>((V + tileRows - 1) / tileRows);
+    #pragma omp parallel for schedule(dynamic, 4)
+    for (long block = 0; block < blocks; ++block)
+    {
+        auto const v0 = static_cast<size_t>(block) * tileRows;
+        // The slice of the rows of W stays in L1 while every right-hand side is accumulated from it.
+        for (size_t begin = 0; begin < B; begin += sliceLength)
+        {
+            auto const end = std::min(B, begin + sliceLength);
+            for (size_t c0 = 0; c0 < k; c0 += tileCols)
+                denseTile(w, values, v0, c0, begin, end, r);
+        }
+    }
+}
+
+/// <summary>
+/// The boundary values transposed to B x k: gathering by boundary index wants the k values of a boundary point next to each other.
+/// </summary>
+static std::vector<double> boundaryMajor(CoordinateMatrix const &values)
+{
+    auto const B = values.cols(), k = values.rows();
+    std::vector<double> d(B * k);
+    for (size_t c = 0; c < k; ++c)
+        for (size_t b = 0; b < B; ++b)
+            d[b * k + c] = values.row(c)[b];
+    return d;
+}
+
+/// <summary>
+/// R += W * D for sparse coordinates, parallelized over vertices.
+/// </summary>
+/// <param name="w">Sparse coordinates of V vertices.</param>
+/// <param name="values">Boundary values, k x B.</param>
+/// <param name="r">Membrane values, V x k row-major.</param>
+void sparseMembranes(SparseCoordinates const &w, CoordinateMatrix const &values, double *r)
+{
+    auto const V = static_cast<long>(w.rows.size()) - 1;
+    auto const k = values.rows();
+    auto const d = boundaryMajor(values);
+
+    #pragma omp parallel for schedule(static)
+    for (long v = 0; v < V; ++v)
+    {
+        auto *rv = r + v * k;
+        for (auto const &bw : w.row(v))
+        {
+            auto const *db = d.data() + static_cast<size_t>(bw.index) * k;
+            for (size_t c = 0; c < k; ++c)
+                rv[c] += bw.weight * db[c];
+        }
+    }
+}
+
+/// <summary>
+/// R += W * D for compressed coordinates stored in one format, parallelized over vertices. Dense rows are decoded one
+/// boundary slice at a time into an L1-resident buffer, from which every right-hand side is accumulated; sparse rows
+/// decode every weight as they gather its boundary values. The scale of a row is applied once to its sums.
+/// </summary>
+template<WeightFormat F>
+static void compressedMembranesAs(CompressedCoordinates const &w, CoordinateMatrix const &values, double *r)
+{
+    using Codec = WeightCodec<F>;
+    auto const V = static_cast<long>(w.rows());
+    auto const B = values.cols(), k = values.rows();
+
+    if (w.dense())
+    {
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (long v = 0; v < V; ++v)
+        {
+            auto const *wv = w.template weights<F>(v);
+            auto const scale = w.scale(v);
+            auto *rv = r + v * k;
+            alignas(CoordinateMatrix::alignment) double slice[sliceLength];
+            for (size_t begin = 0; begin < B; begin += sliceLength)
+            {
+                auto const n = std::min(B - begin, sliceLength);
+                #pragma omp simd
+                for (size_t b = 0; b < n; ++b)
+                    slice[b] = Codec::decode(wv[begin + b]);
+
+                for (size_t c = 0; c < k; ++c)
+                {
+                    auto const *dc = values.row(c) + begin;
+                    auto acc = 0.0;
+                    #pragma omp simd reduction(+:acc)
+                    for (size_t b = 0; b < n; ++b)
+                        acc += slice[b] * dc[b];
+                    rv[c] += scale * acc;
+                }
+            }
+        }
+        return;
+    }
+
+    auto const d = boundaryMajor(values);
+    #pragma omp parallel for schedule(static)
+    for (long v = 0; v < V; ++v)
+    {
+        auto const *wv = w.template weights<F>(v);
+        auto const *iv = w.indices(v);
+        auto const n = w.size(v);
+        auto const scale = w.scale(v);
+        auto *rv = r + v * k;
+        for (size_t i = 0; i < n; ++i)
+        {
+            auto const weight = scale * Codec::decode(wv[i]);
+            auto const *db = d.data() + static_cast<size_t>(iv[i]) * k;
+            for (size_t c = 0; c < k; ++c)
+                rv[c] += weight * db[c];
+        }
+    }
+}
+
+/// <summary>
+/// R += W * D for compressed coordinates.
+/// </summary>
+/// <param name="w">Compressed coordinates of V vertices.</param>
+/// <param name="values">Boundary values, k x B.</param>
+/// <param name="r">Membrane values, V x k row-major.</param>
+void compressedMembranes(CompressedCoordinates const &w, CoordinateMatrix const &values, double *r)
+{
+    if (w.empty() || values.rows() == 0) return;
+
+    switch (w.format())
+    {
+        case WeightFormat::Float: compressedMembranesAs<WeightFormat::Float>(w, values, r); break;
+        case WeightFormat::Half: compressedMembranesAs<WeightFormat::Half>(w, values, r); break;
+        case WeightFormat::BFloat16: compressedMembranesAs<WeightFormat::BFloat16>(w, values, r); break;
+        case WeightFormat::Int16: compressedMembranesAs<WeightFormat::Int16>(w, values, r); break;
+        case WeightFormat::Int8: compressedMembranesAs<WeightFormat::Int8>(w, values, r); break;
+        default: compressedMembranesAs<WeightFormat::Double>(w, values, r); break;
+    }
+}
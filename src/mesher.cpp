@@ -0,0 +1,22 @@
+#include "mesher.hpp"
+
+/// <summary>
+/// Creates the mesher of a backend.
+/// </summary>
+std::unique_ptr<Mesher> Mesher::create(MeshBackend backend)
+{
+    switch (backend)
+    {
+        case MeshBackend::CGAL: return std::make_unique<CGALMesher>();
+        case MeshBackend::Quadtree: return std::make_unique<QuadtreeMesher>();
+    }
+    throw std::invalid_argument("unknown mesh backend " + std::to_string(static_cast<uint32_t>(backend)));
+}
+
+void CGALMesher::mesh(Boundary const &boundary, std::vector<Point_2> &vertices, std::vector<std::array<int, 3>> &triangles) const
+{
+    AdaptiveMesh mesh;
+    mesh.createMesh(boundary);
+    vertices = mesh.vertices();
+    triangles = mesh.triangles();
+}
@@ -0,0 +1,219 @@
+#include "mvc_kernel.hpp"
+
+/// <summary>
+/// Copies the boundary into structure-of-arrays buffers and indexes its points, so that mesh vertices
+/// that came from the boundary constraints can be recognized in constant time.
+/// </summary>
+/// <param name="boundary">Boundary rings.</param>
+template <typename T>
+MVCKernel<T>::MVCKernel(Boundary const &boundary)
+    : m_start(boundary.rings)
+{
+    m_x.reserve(boundary.size() + boundary.ringCount());
+    m_y.reserve(boundary.size() + boundary.ringCount());
+    for (int r = 0; r < boundary.ringCount(); ++r)
+    {
+        for (int i = boundary.rings[r]; i < boundary.rings[r + 1]; ++i)
+        {
+            m_x.push_back(static_cast<T>(boundary[i].x()));
+            m_y.push_back(static_cast<T>(boundary[i].y()));
+            m_index.insert({boundary[i], i});
+        }
+        m_x.push_back(static_cast<T>(boundary[boundary.rings[r]].x()));
+        m_y.push_back(static_cast<T>(boundary[boundary.rings[r]].y()));
+    }
+    m_seam.assign(m_x.size(), 0);
+    for (int r = 0; r + 1 < boundary.ringCount(); ++r)
+        m_seam[static_cast<size_t>(boundary.rings[r + 1] + r)] = 1;
+}
+
+/// <summary>
+/// Finds a point on the boundary.
+/// </summary>
+/// <returns>The index of p in the boundary, or -1 if p is not a boundary point.</returns>
+template <typename T>
+int MVCKernel<T>::boundaryIndex(Point_2 const &p) const
+{
+    auto const it = m_index.find(p);
+    return it == m_index.end() ? -1 : it->second;
+}
+
+/// <summary>
+/// Computes the mean-value coordinates of a list of points. Blocks of points are distributed over the OpenMP threads.
+/// </summary>
+/// <param name="xs">Points inside (or on) the boundary.</param>
+/// <param name="rows">For every point, the output buffer of size() weights.</param>
+template <typename T>
+void MVCKernel<T>::compute(std::span<Point_2 const> xs, std::span<double *const> rows) const
+{
+    auto const B = size();
+
+    // Boundary points get identity weights without looking at the rest of the boundary.
+    std::vector<int> inner;
+    for (size_t k = 0; k < xs.size(); ++k)
+    {
+        auto const i = boundaryIndex(xs[k]);
+        if (i < 0)
+        {
+            inner.push_back(static_cast<int>(k));
+            continue;
+        }
+        std::fill(rows[k], rows[k] + B, 0.0);
+        rows[k][i] = 1.0;
+    }
+
+    auto const blocks = (static_cast<int>(inner.size()) + lanes - 1) / lanes;
+    #pragma omp parallel
+    {
+        std::vector<T> scratch(static_cast<size_t>(lanes) * 4 * m_x.size());
+
+        #pragma omp for schedule(dynamic)
+        for (int b = 0; b < blocks; ++b)
+        {
+            std::array<Point_2, lanes> block;
+            std::array<double *, lanes> blockRows;
+            auto const count = std::min(lanes, static_cast<int>(inner.size()) - b * lanes);
+            for (int l = 0; l < count; ++l)
+            {
+                auto const k = inner[b * lanes + l];
+                block[l] = xs[k];
+                blockRows[l] = rows[k];
+            }
+            computeBlock(block, blockRows, count, scratch);
+        }
+    }
+}
+
+/// <summary>
+/// Computes the coordinates of up to `lanes` points that are not boundary points.
+/// </summary>
+template <typename T>
+void MVCKernel<T>::computeBlock(std::array<Point_2, lanes> const &xs, std::array<double *, lanes> const &rows, int count, std::vector<T> &scratch) const
+{
+    auto const B = size();
+    auto const n = static_cast<int>(m_x.size());
+    auto const stride = m_x.size();
+    auto const *bx = m_x.data();
+    auto const *by = m_y.data();
+
+    // Unused lanes repeat the last point; their results are dropped.
+    std::array<T, lanes> px, py;
+    std::array<T *, lanes> dx, dy, r, t;
+    for (int l = 0; l < lanes; ++l)
+    {
+        auto const &x = xs[std::min(l, count - 1)];
+        px[l] = static_cast<T>(x.x());
+        py[l] = static_cast<T>(x.y());
+        dx[l] = scratch.data() + (4 * l + 0) * stride;
+        dy[l] = scratch.data() + (4 * l + 1) * stride;
+        r[l] = scratch.data() + (4 * l + 2) * stride;
+        t[l] = scratch.data() + (4 * l + 3) * stride;
+    }
+
+    // Vectors from every point to every boundary point (the closing points included) and their lengths.
+    #pragma omp simd
+    for (int i = 0; i < n; ++i)
+    {
+        for (int l = 0; l < lanes; ++l)
+        {
+            auto const ux = bx[i] - px[l];
+            auto const uy = by[i] - py[l];
+            dx[l][i] = ux;
+            dy[l][i] = uy;
+            r[l][i] = std::sqrt(ux * ux + uy * uy);
+        }
+    }
+
+    // Half-angle tangent of the angle spanned by every boundary edge, from the cross and dot products.
+    // The entry of the closing point of a ring pairs it with the next ring and is never read.
+    // A point on an edge sees its end points in opposite directions (cross ~ 0, dot <= 0): the tangent of that edge
+    // is then 0/0, or a rounded denominator of a few ulps on diagonal edges, so such lanes are flagged in a bit mask.
+    auto const collinear = 64 * std::numeric_limits<T>::epsilon();
+    int onEdge = 0;
+    #pragma omp simd reduction(|:onEdge)
+    for (int i = 0; i < n - 1; ++i)
+    {
+        for (int l = 0; l < lanes; ++l)
+        {
+            auto const cross = dx[l][i] * dy[l][i + 1] - dy[l][i] * dx[l][i + 1];
+            auto const dot = dx[l][i] * dx[l][i + 1] + dy[l][i] * dy[l][i + 1];
+            auto const rr = r[l][i] * r[l][i + 1];
+            onEdge |= (!m_seam[i] && std::abs(cross) <= collinear * rr && dot <= 0) << l;
+            t[l][i] = cross / (rr + dot);
+        }
+    }
+
+    for (int l = 0; l < count; ++l)
+    {
+        auto *w = rows[l];
+        auto const *tl = t[l];
+        auto const *rl = r[l];
+
+        auto total = 0.0;
+        for (size_t ring = 0; ring + 1 < m_start.size(); ++ring)
+        {
+            // Boundary point i of this ring is element i + ring of the closed polygons.
+            auto const begin = m_start[ring], end = m_start[ring + 1];
+            auto const *tr = tl + ring;
+            auto const *rr = rl + ring;
+
+            w[begin] = static_cast<double>((tr[end - 1] + tr[begin]) / rr[begin]);
+            total += w[begin];
+            #pragma omp simd reduction(+:total)
+            for (int i = begin + 1; i < end; ++i)
+            {
+                w[i] = static_cast<double>((tr[i - 1] + tr[i]) / rr[i]);
+                total += w[i];
+            }
+        }
+
+        if ((onEdge >> l) & 1 || !std::isfinite(total))
+        {
+            computeOnEdge(xs[l], w);
+            continue;
+        }
+
+        // Normalize lambdas
+        auto const factor = 1.0 / total;
+        #pragma omp simd
+        for (int i = 0; i < B; ++i)
+            w[i] *= factor;
+    }
+}
+
+/// <summary>
+/// Coordinates of a point lying on a boundary edge: it is a linear interpolation between the two end points of that edge.
+/// </summary>
+template <typename T>
+void MVCKernel<T>::computeOnEdge(Point_2 const &x, double *row) const
+{
+    auto const B = size();
+    auto best = 0, bestNext = 0;
+    auto bestGap = std::numeric_limits<double>::max();
+    std::array<double, 2> bestWeights {1.0, 0.0};
+    for (size_t ring = 0; ring + 1 < m_start.size(); ++ring)
+    {
+        for (int i = m_start[ring]; i < m_start[ring + 1]; ++i)
+        {
+            // The point is on the edge when the detour over it is no longer than the edge itself.
+            auto const e = i + static_cast<int>(ring);
+            auto const ra = std::hypot(m_x[e] - x.x(), m_y[e] - x.y());
+            auto const rb = std::hypot(m_x[e + 1] - x.x(), m_y[e + 1] - x.y());
+            auto const gap = ra + rb - std::hypot(m_x[e + 1] - m_x[e], m_y[e + 1] - m_y[e]);
+            if (gap < bestGap)
+            {
+                best = i;
+                bestNext = i + 1 == m_start[ring + 1] ? m_start[ring] : i + 1;
+                bestGap = gap;
+                bestWeights = {rb / (ra + rb), ra / (ra + rb)};
+            }
+        }
+    }
+
+    std::fill(row, row + B, 0.0);
+    row[best] += bestWeights[0];
+    row[bestNext] += bestWeights[1];
+}
+
+template class MVCKernel<float>;
+template class MVCKernel<double>;
@@ -0,0 +1,190 @@
+#include "mvc_plan.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+/// <summary>
+/// Allocates a zero-initialized, aligned and padded matrix.
+/// </summary>
+/// <param name="rows">Number of mesh vertices.</param>
+/// <param name="cols">Number of boundary points.</param>
+CoordinateMatrix::CoordinateMatrix(size_t rows, size_t cols)
+    : m_rows(rows), m_cols(cols), m_stride(stride(cols))
+{
+    auto const bytes = std::max<size_t>(m_rows * m_stride * sizeof(double), alignment);
+    auto *data = static_cast<double *>(::operator new[](bytes, std::align_val_t(alignment)));
+    std::fill(data, data + m_rows * m_stride, 0.0);
+    m_data = std::shared_ptr<double>(data, [](double *d) { ::operator delete[](d, std::align_val_t(alignment)); });
+}
+
+/// <summary>
+/// Wraps existing storage laid out with stride(cols) doubles per row. The matrix shares ownership of it.
+/// </summary>
+/// <param name="rows">Number of mesh vertices.</param>
+/// <param name="cols">Number of boundary points.</param>
+/// <param name="data">Storage of at least rows * stride(cols) doubles, aligned to `alignment` bytes.</param>
+CoordinateMatrix::CoordinateMatrix(size_t rows, size_t cols, std::shared_ptr<double> data)
+    : m_rows(rows), m_cols(cols), m_stride(stride(cols)), m_data(std::move(data))
+{
+}
+
+/// <summary>
+/// Approximate memory held by a plan: the boundary, the mesh and the coordinates in whichever form it has them.
+/// </summary>
+size_t MVCPlan::bytes() const
+{
+    return boundary.size() * sizeof(Point_2) + vertices.size() * sizeof(Point_2) + triangles.size() * sizeof(triangles[0])
+        + coordinates.rows() * coordinates.stride() * sizeof(double)
+        + sparseCoordinates.weights.size() * sizeof(BoundaryWeight) + sparseCoordinates.rows.size() * sizeof(int64_t)
+        + compressedCoordinates.bytes();
+}
+
+/// <summary>
+/// Takes ownership of the plans of a mask. The mask is copied, so later changes to the caller's image do not affect the plan.
+/// </summary>
+/// <param name="mask">Single-channel 8-bit mask the plans were built from.</param>
+/// <param name="components">One plan per mask component, largest first.</param>
+ClonePlan::ClonePlan(cv::Mat const &mask, std::vector<MVCPlan> components)
+    : m_state(std::make_shared<State const>(State{mask.clone(), std::move(components)}))
+{
+}
+
+/// <summary>
+/// Approximate memory held by the plan, mask included.
+/// </summary>
+size_t ClonePlan::bytes() const
+{
+    if (!m_state)
+        return 0;
+    auto bytes = m_state->mask.total() * m_state->mask.elemSize();
+    for (auto const &component : m_state->components)
+        bytes += component.bytes();
+    return bytes;
+}
+
+/// <summary>
+/// Compresses the dense or sparse coordinates of a plan.
+/// </summary>
+/// <param name="plan">Plan holding the coordinates of the sampling mode it was built with.</param>
+/// <param name="options">Storage format and dropping threshold.</param>
+CompressedCoordinates CompressedCoordinates::compress(MVCPlan const &plan, CompressionOptions const &options)
+{
+    switch (options.format)
+    {
+        case WeightFormat::Float: return compressAs<WeightFormat::Float>(plan, options);
+        case WeightFormat::Half: return compressAs<WeightFormat::Half>(plan, options);
+        case WeightFormat::BFloat16: return compressAs<WeightFormat::BFloat16>(plan, options);
+        case WeightFormat::Int16: return compressAs<WeightFormat::Int16>(plan, options);
+        case WeightFormat::Int8: return compressAs<WeightFormat::Int8>(plan, options);
+        default: return compressAs<WeightFormat::Double>(plan, options);
+    }
+}
+
+/// <summary>
+/// Compresses the coordinates of a plan into one format. Rows are encoded in parallel: every row drops its small weights,
+/// rescales the rest to the original sum, and then puts the rounding error of that sum back on its largest weight.
+/// </summary>
+template<WeightFormat F>
+CompressedCoordinates CompressedCoordinates::compressAs(MVCPlan const &plan, CompressionOptions const &options)
+{
+    using Codec = WeightCodec<F>;
+    using Stored = typename Codec::Stored;
+
+    auto const sparse = plan.sampling.mode == Sampling::Hierarchical;
+    CompressedCoordinates out;
+    out.m_format = F;
+    out.m_cols = sparse ? plan.boundary.size() : plan.coordinates.cols();
+    out.m_dense = !sparse && options.threshold <= 0.0;
+    auto const V = static_cast<long>(sparse ? plan.sparseCoordinates.rows.size() - 1 : plan.coordinates.rows());
+
+    auto const visit = [&](long v, auto &&f)
+    {
+        if (sparse)
+        {
+            for (auto const &bw : plan.sparseCoordinates.row(v))
+                f(bw.index, bw.weight);
+            return;
+        }
+        auto const *w = plan.coordinates.row(v);
+        for (size_t b = 0; b < out.m_cols; ++b)
+            f(static_cast<int>(b), w[b]);
+    };
+
+    // Largest weight and number of kept weights of every row, then the row offsets.
+    std::vector<double> largest(V, 0.0);
+    std::vector<int64_t> counts(V, 0);
+    #pragma omp parallel for schedule(static)
+    for (long v = 0; v < V; ++v)
+    {
+        visit(v, [&](int, double w) { largest[v] = std::max(largest[v], std::abs(w)); });
+        visit(v, [&](int, double w) { counts[v] += out.m_dense || std::abs(w) >= options.threshold * largest[v]; });
+    }
+    out.m_rows.resize(V + 1);
+    for (long v = 0; v < V; ++v)
+        out.m_rows[v + 1] = out.m_rows[v] + counts[v];
+
+    auto const total = out.m_rows.back();
+    out.m_data.resize(static_cast<size_t>(total) * sizeof(Stored));
+    if (!out.m_dense)
+        out.m_indices.resize(total);
+    if (Codec::range > 0.0)
+        out.m_scales.resize(V);
+
+    auto *data = reinterpret_cast<Stored *>(out.m_data.data());
+    auto maxError = 0.0;
+    #pragma omp parallel for schedule(dynamic, 16) reduction(max:maxError)
+    for (long v = 0; v < V; ++v)
+    {
+        auto const begin = out.m_rows[v];
+        auto *q = data + begin;
+
+        // Kept weights, and the row sums before and after dropping.
+        std::vector<int> index;
+        std::vector<double> kept;
+        index.reserve(counts[v]);
+        kept.reserve(counts[v]);
+        double sum = 0.0, keptSum = 0.0, dropped = 0.0;
+        visit(v, [&](int b, double w)
+        {
+            sum += w;
+            if (out.m_dense || std::abs(w) >= options.threshold * largest[v])
+            {
+                index.push_back(b);
+                kept.push_back(w);
+                keptSum += w;
+            }
+            else
+                dropped += std::abs(w);
+        });
+        auto const factor = keptSum != 0.0 ? sum / keptSum : 1.0;
+
+        auto scale = 1.0;
+        if (Codec::range > 0.0)
+        {
+            auto const peak = largest[v] * std::abs(factor);
+            out.m_scales[v] = static_cast<float>(peak > 0.0 ? peak / Codec::range : 1.0);
+            scale = out.m_scales[v];
+        }
+
+        size_t top = 0;
+        double encodedSum = 0.0;
+        for (size_t i = 0; i < kept.size(); ++i)
+        {
+            q[i] = Codec::encode(kept[i] * factor / scale);
+            encodedSum += Codec::decode(q[i]) * scale;
+            if (std::abs(kept[i]) > std::abs(kept[top]))
+                top = i;
+        }
+        if (!kept.empty())
+            q[top] = Codec::encode(Codec::decode(q[top]) + (sum - encodedSum) / scale);
+
+        auto error = dropped;
+        for (size_t i = 0; i < kept.size(); ++i)
+            error += std::abs(kept[i] - Codec::decode(q[i]) * scale);
+        if (!out.m_dense)
+            std::copy(index.begin(), index.end(), out.m_indices.begin() + begin);
+        maxError = std::max(maxError, error);
+    }
+    out.m_maxError = maxError;
+    return out;
+}
@@ -1,167 +1,898 @@
 #include "mvc_solver.hpp"
 
+#include <bit>
+
 /// <summary>
 /// Function used to generate the mean-value coordinates between a fixed point p and all points on the mesh boundary.
+/// This is the scalar reference implementation; preprocessing uses the vectorized MVCKernel, which computes the same coordinates.
 /// </summary>
 /// <param name="p">Fixed vertex inside the mesh.</param>
-/// <param name="ps">List of boundary vertices.</param>
+/// <param name="ps">Boundary rings.</param>
 /// <returns>The list of mean-value coordinates (lambdas in the paper).</returns>
-std::vector<double> MVCSolver::mvc(Point_2 const &p, const std::vector<Point_2> &ps)
+std::vector<double> MVCSolver::mvc(Point_2 const &p, Boundary const &ps) const
 {
-	std::vector<double> w;
-	auto x = glm::vec2(p.x(), p.y());
+	std::vector<double> w(ps.size(), 0.0);
+	auto x = glm::dvec2(p.x(), p.y());
 	
 	// Case in which fixed vertex is very close to the boundary.
-	int loc = -1;
-	#pragma omp parallel for
-	for (int i = 0; i < ps.size(); ++i)
-	{
-		// If distance between fixed point and current point on boundary is small break and compute lambda;
-		auto p = glm::vec2(ps[i].x(), ps[i].y());
-		if (glm::distance(p, x) < 1e-4)
-			loc = i;
-	}
-	if(loc >= 0)
+	for (size_t i = 0; i < ps.size(); ++i)
 	{
-		for (int i = 0; i < ps.size(); ++i)
-			w.push_back(0.0);
-
-		w[loc] = 1; 
-		
-		return w;
+		if (glm::distance(glm::dvec2(ps[i].x(), ps[i].y()), x) < 1e-4)
+		{
+			w[i] = 1.0;
+			return w;
+		}
 	}
 
 	// Case in which the fixed vertex is relatively far from the boundary.
 	auto total = 0.0;
-	// #pragma omp parallel for
-	for (int i = 0; i < ps.size(); i++)
-	{
-		// Retrieve the previous (i-1), current (i) and next (i) vertices on boundary.
-		auto vi = glm::vec2(ps[i].x(), ps[i].y());
-		auto vi_left = glm::vec2(ps[(i-1 + ps.size())%ps.size()].x(), ps[(i-1 + ps.size())%ps.size()].y());
-		auto vi_right = glm::vec2(ps[(i+1)%ps.size()].x(), ps[(i+1)%ps.size()].y());
-		
-		// Calculate the vector going from current (i) checked point on boundary and fixed vertex x
-		auto viP = glm::normalize(vi - x);
-
-		// Calculate angles
-		auto angle1 = getAngle(vi_left - x, viP);
-		auto angle2 = getAngle(viP, vi_right - x);
-		auto t1 = tan(angle2*0.5);
+	for (size_t i = 0; i < ps.size(); i++)
+	{
+		// Retrieve the previous (i-1), current (i) and next (i) vertices on the ring of i.
+		auto const &left = ps[ps.prev(static_cast<int>(i))];
+		auto const &right = ps[ps.next(static_cast<int>(i))];
+		auto vi = glm::dvec2(ps[i].x(), ps[i].y());
+		auto vi_left = glm::dvec2(left.x(), left.y());
+		auto vi_right = glm::dvec2(right.x(), right.y());
+
+		// Calculate angles between the vectors going from x to the previous, current and next boundary points
+		auto angle1 = getAngle(vi_left - x, vi - x);
+		auto angle2 = getAngle(vi - x, vi_right - x);
+		auto t1 = tan(angle1*0.5);
 		auto t2 = tan(angle2*0.5);
 
 		// Populate weights list
-		w.push_back((t1+t2)/glm::distance(vi, x));
+		w[i] = (t1+t2)/glm::distance(vi, x);
 		// Calculate total
 		total += w[i];
+	}
+
+	// Normalize lambdas
+	auto factor = 1.0/total;
+	for (auto &wi : w)
+		wi *= factor;
+
+	return w;
+}
+
+/// <summary>
+/// Recursively subdivides the boundary segment [a, b] while it looks large from x, collecting the start point of every final segment.
+/// </summary>
+/// <param name="x">Fixed vertex inside the mesh.</param>
+/// <param name="ps">Boundary rings.</param>
+/// <param name="arc">Arc length along the rings up to every point, see preprocessing.</param>
+/// <param name="a">First point of the segment.</param>
+/// <param name="b">Last point of the segment (may be the end of the ring, which wraps around to its first point).</param>
+/// <param name="epsilon">Accuracy threshold.</param>
+/// <param name="samples">Collected boundary indices, in boundary order.</param>
+static void sampleSegment(glm::dvec2 const &x, Boundary const &ps, std::vector<double> const &arc, int a, int b, double epsilon, std::vector<int> &samples)
+{
+	if (b - a > 1)
+	{
+		// All points of the segment lie within half its arc length of its middle point.
+		auto const mid = (a + b) / 2;
+		auto const length = arc[b] - arc[a];
+		auto const d = glm::distance(x, glm::dvec2(ps[mid].x(), ps[mid].y())) - 0.5 * length;
+		if (d <= 0.0 || length > epsilon * d)
+		{
+			sampleSegment(x, ps, arc, a, mid, epsilon, samples);
+			sampleSegment(x, ps, arc, mid, b, epsilon, samples);
+			return;
+		}
+	}
+	samples.push_back(a);
+}
+
+/// <summary>
+/// Hierarchical version of mvc. The boundary is sampled adaptively as seen from p: densely where it is close to p and coarsely
+/// far away from it, and the mean-value coordinates are computed with respect to the polygons of the sampled points.
+/// </summary>
+/// <param name="p">Fixed vertex inside the mesh.</param>
+/// <param name="ps">Boundary rings.</param>
+/// <param name="arc">Arc length along the rings up to every point, see preprocessing.</param>
+/// <param name="epsilon">Accuracy threshold, see SamplingOptions.</param>
+/// <returns>The sparse list of mean-value coordinates, in boundary order.</returns>
+std::vector<BoundaryWeight> MVCSolver::mvcHierarchical(Point_2 const &p, Boundary const &ps, std::vector<double> const &arc, double epsilon) const
+{
+	auto const x = glm::dvec2(p.x(), p.y());
+
+	// Start from a few coarse segments per ring and refine them. Samples of ring r are samples[first[r]] up to samples[first[r + 1]].
+	// Both lists are per-thread scratch, reused by every vertex the thread samples.
+	thread_local std::vector<int> samples, first;
+	samples.clear();
+	first.assign(1, 0);
+	for (int r = 0; r < ps.ringCount(); ++r)
+	{
+		auto const begin = ps.rings[r];
+		auto const n = ps.rings[r + 1] - begin;
+		auto const segments = std::min(n, 8);
+		for (int k = 0; k < segments; ++k)
+			sampleSegment(x, ps, arc, begin + k * n / segments, begin + (k + 1) * n / segments, epsilon, samples);
+		first.push_back(static_cast<int>(samples.size()));
+	}
+
+	auto point = [&](int j) { auto const &q = ps[samples[j]]; return glm::dvec2(q.x(), q.y()); };
+
+	// Case in which fixed vertex is very close to the boundary. Boundary points that close to p are always sampled.
+	for (size_t j = 0; j < samples.size(); ++j)
+		if (glm::distance(point(j), x) < 1e-4)
+			return {BoundaryWeight{samples[j], 1.0}};
+
+	std::vector<BoundaryWeight> w;
+	w.reserve(samples.size());
+	auto total = 0.0;
+	for (int r = 0; r < ps.ringCount(); ++r)
+	{
+		auto const m = first[r + 1] - first[r];
+		auto ringPoint = [&](int j) { return point(first[r] + (j + m) % m); };
+		for (int j = 0; j < m; ++j)
+		{
+			auto const vi = ringPoint(j) - x;
+
+			// On the edge to the next sample, the tangent of that edge is 0/0 (or rounds to 0): p is then the linear
+			// interpolation of the end points of the edge, as in MVCKernel::computeOnEdge.
+			auto const vn = ringPoint(j + 1) - x;
+			auto const ri = glm::length(vi), rn = glm::length(vn);
+			if (std::abs(vi.x * vn.y - vi.y * vn.x) <= 64 * std::numeric_limits<double>::epsilon() * ri * rn && glm::dot(vi, vn) <= 0.0)
+			{
+				BoundaryWeight a {samples[first[r] + j], rn / (ri + rn)}, b {samples[first[r] + (j + 1) % m], ri / (ri + rn)};
+				if (b.index < a.index)
+					std::swap(a, b);
+				return {a, b};
+			}
+			auto const t1 = halfAngleTan(ringPoint(j - 1) - x, vi);
+			auto const t2 = halfAngleTan(vi, ringPoint(j + 1) - x);
 
+			w.push_back({samples[first[r] + j], (t1 + t2) / glm::length(vi)});
+			total += w.back().weight;
+		}
 	}
 
 	// Normalize lambdas
-    float factor = 1.0/total;
-	// #pragma omp parallel for
-	for (int i = 0; i < ps.size(); ++i)
-		w[i] *= factor;
+	for (auto &bw : w)
+		bw.weight /= total;
 
 	return w;
 }
 
+/// <summary>
+/// First half of the preprocessing stage: the adaptive mesh of a boundary, built by the selected mesher. Meshing is
+/// sequential, so independent components are meshed concurrently.
+/// </summary>
+/// <param name="boundary">Boundary rings of one mask component.</param>
+/// <returns>The plan holding the mesh, without coordinates.</returns>
+MVCPlan MVCSolver::meshing(Boundary const &boundary) const
+{
+	MVCPlan plan;
+	plan.boundary = boundary;
+	plan.mesher = m_mesher;
+	plan.sampling = m_sampling;
+
+    // Compute mesh
+	Mesher::create(m_mesher)->mesh(boundary, plan.vertices, plan.triangles);
+	Trace::count("mesh.vertices", static_cast<int64_t>(plan.vertices.size()));
+	Trace::count("mesh.triangles", static_cast<int64_t>(plan.triangles.size()));
+
+	return plan;
+}
+
+/// <summary>
+/// Second half of the preprocessing stage: the mean-value coordinates of every mesh vertex, computed in parallel.
+/// </summary>
+/// <param name="plan">Plan holding the mesh.</param>
+void MVCSolver::coordinates(MVCPlan &plan) const
+{
+	TRACE_SCOPE("coordinates");
+	auto const &boundary = plan.boundary;
+	if (plan.sampling.mode == Sampling::Hierarchical)
+	{
+		// Arc length along the rings up to every point, used to bound the extent of boundary segments.
+		auto const arc = arcLengths(boundary);
+
+		// Sample every vertex in parallel, then concatenate the rows.
+		std::vector<std::vector<BoundaryWeight>> ws(plan.vertices.size());
+		#pragma omp parallel for schedule(dynamic, 16)
+		for (int i = 0; i < static_cast<int>(ws.size()); ++i)
+			ws[i] = mvcHierarchical(plan.vertices[i], boundary, arc, plan.sampling.epsilon);
+
+		for (auto const &w : ws)
+		{
+			plan.sparseCoordinates.weights.insert(plan.sparseCoordinates.weights.end(), w.begin(), w.end());
+			plan.sparseCoordinates.rows.push_back(static_cast<int64_t>(plan.sparseCoordinates.weights.size()));
+		}
+		Trace::count("coordinates.weights", static_cast<int64_t>(plan.sparseCoordinates.weights.size()));
+
+		return;
+	}
+
+	// Compute MVC coordinates for each vertex, one row of the coordinate matrix per vertex.
+	plan.coordinates = CoordinateMatrix(plan.vertices.size(), boundary.size());
+	std::vector<double *> rows;
+	rows.reserve(plan.vertices.size());
+	for (size_t i = 0; i < plan.vertices.size(); ++i)
+		rows.push_back(plan.coordinates.row(i));
+	MVCKernel<double>(boundary).compute(plan.vertices, rows);
+	Trace::count("coordinates.weights", static_cast<int64_t>(plan.vertices.size() * boundary.size()));
+
+#ifndef NDEBUG
+	// Cross-check the vectorized kernel against the scalar reference implementation.
+	for (size_t i = 0; i < plan.vertices.size(); ++i)
+	{
+		auto const reference = mvc(plan.vertices[i], boundary);
+		for (size_t j = 0; j < boundary.size(); ++j)
+			assert(std::abs(plan.coordinates.row(i)[j] - reference[j]) < 1e-6);
+	}
+#endif
+}
+
+/// <summary>
+/// Replaces the coordinates of a plan by their compressed form, if compression is enabled.
+/// </summary>
+/// <param name="plan">Plan holding dense or sparse coordinates.</param>
+void MVCSolver::compress(MVCPlan &plan) const
+{
+	if (!m_compression)
+		return;
+
+	TRACE_SCOPE("compress");
+	plan.compressedCoordinates = CompressedCoordinates::compress(plan, *m_compression);
+	plan.coordinates = CoordinateMatrix();
+	plan.sparseCoordinates = SparseCoordinates();
+	Trace::count("coordinates.bytes", static_cast<int64_t>(plan.compressedCoordinates.bytes()));
+}
+
 /// <summary>
 /// Preprocessing stage of the algorithm. Pre-computes an adaptive mesh and the mean-value coordinates of each vertex in the mesh
 /// </summary>
+/// <param name="boundary">Boundary rings of one mask component.</param>
+/// <returns>The plan holding the mesh and the mean-value coordinates of every mesh vertex, indexed by vertex.</returns>
+MVCPlan MVCSolver::preprocessing(Boundary const &boundary) const
+{
+	auto plan = meshing(boundary);
+	coordinates(plan);
+	return plan;
+}
+
+/// <summary>
+/// Retrieves the plans of all components of a mask. Components missing from the plan cache are meshed concurrently; their
+/// coordinates are then computed one component at a time, each in parallel over its vertices. With compression enabled,
+/// the coordinates are compressed after caching, and their size and error bound are reported.
+/// </summary>
 /// <param name="mask">ROI image.</param>
-/// <param name="boundary">List of boundary vertices.</param>
-/// <returns>A dictionary containing points as keys and their respective mean-value coordinates as value.</returns>
-std::unordered_map<Point_2, std::vector<double>> MVCSolver::preprocessing(cv::Mat const &mask, std::vector<Point_2> const &boundary)
+/// <returns>One plan per mask component, largest first.</returns>
+std::vector<MVCPlan> MVCSolver::plans(cv::Mat const &mask) const
 {
-    // Compute mesh
-	m_mesh.createMesh(boundary);
-	auto vs = m_mesh.vertices();
+	std::vector<Boundary> boundaries;
+	{
+		TRACE_SCOPE("boundary");
+		boundaries = getBoundaries(mask, m_tolerance);
+	}
+	auto const C = static_cast<int>(boundaries.size());
+	for (auto const &boundary : boundaries)
+		Trace::count("boundary.points", static_cast<int64_t>(boundary.size()));
+
+	std::vector<MVCPlan> plans(C);
+	std::vector<char> cached(C, 0);
+	if (m_cache)
+	{
+		TRACE_SCOPE("cache.load");
+		for (int c = 0; c < C; ++c)
+		{
+			if (auto plan = m_cache->load(boundaries[c], m_sampling, m_mesher))
+			{
+				plans[c] = std::move(*plan);
+				cached[c] = 1;
+			}
+		}
+	}
 
-	// Compute MVC coordinates for each vertex
-	std::unordered_map<Point_2, std::vector<double>> coordinates;
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int c = 0; c < C; ++c)
+		if (!cached[c])
+			plans[c] = meshing(boundaries[c]);
 
-	// #pragma omp parallel for
-	// Populate the map
-	for(auto const &p : vs)
+	for (int c = 0; c < C; ++c)
 	{
-		auto key = std::to_string(p.x()) + std::to_string(p.y());
-		// #pragma omp critical
-		coordinates.insert({p, mvc(p, boundary)});
+		if (cached[c])
+			continue;
+		coordinates(plans[c]);
+		if (m_cache)
+		{
+			TRACE_SCOPE("cache.store");
+			m_cache->store(plans[c]);
+		}
 	}
 
-	return coordinates;
+	if (m_compression)
+	{
+		// Size of the plans before and after, and the colour error bound per unit of boundary difference.
+		size_t before = 0, after = 0;
+		auto maxError = 0.0;
+		for (auto &plan : plans)
+		{
+			before += plan.bytes();
+			compress(plan);
+			after += plan.bytes();
+			maxError = std::max(maxError, plan.compressedCoordinates.maxError());
+		}
+		// On stderr: stdout may carry a protocol, e.g. the answers of the job server.
+		std::cerr << "plans: " << before / 1048576.0 << " MB -> " << after / 1048576.0 << " MB, colour error at most "
+			<< maxError << " x the largest boundary difference" << "\n";
+	}
+
+	return plans;
+}
+
+/// <summary>
+/// Runs the preprocessing stage for a whole mask and freezes the result. The plan can then be solved with from any
+/// number of threads at once, with any sources and targets, see solve(ClonePlan const &, ...).
+/// </summary>
+/// <param name="mask">Mask of the region to clone; non-zero pixels are inside.</param>
+/// <returns>The immutable plan of the mask.</returns>
+ClonePlan MVCSolver::prepare(cv::Mat const &mask) const
+{
+	return ClonePlan(maskPlane(mask), plans(mask));
+}
+
+/// <summary>
+/// Checks that a job can be solved without reading outside of its images: the mask must have the size of the source,
+/// and the boundary, which lies within the bounding box of the mask, must land inside the target at the offset.
+/// </summary>
+/// <param name="src">Size of the source image.</param>
+/// <param name="mask">Mask of the region to clone.</param>
+/// <param name="dest">Size of the target image.</param>
+/// <param name="offset">Position offset of the mask inside the target image space.</param>
+void MVCSolver::checkPlacement(cv::Size const &src, cv::Mat const &mask, cv::Size const &dest, glm::vec2 const &offset)
+{
+	if (mask.size() != src)
+		throw std::invalid_argument("the mask must have the size of the source");
+
+	auto const bbox = SpanMask(mask).bbox();
+	if (bbox.empty())
+		return;
+	if (bbox.x + offset.x < 0 || bbox.y + offset.y < 0 || bbox.br().x - 1 + offset.x >= dest.width || bbox.br().y - 1 + offset.y >= dest.height)
+		throw std::invalid_argument("the mask does not fit inside the target at offset [" + std::to_string(offset.x) + ", " + std::to_string(offset.y) + "]");
+}
+
+/// <summary>
+/// Clones the masked region of a source into a single target with a prepared plan. Reads the plan only, so concurrent
+/// calls may share it.
+/// </summary>
+/// <param name="plan">Plan of the mask, see prepare.</param>
+/// <param name="src">Source image, at least as large as the mask.</param>
+/// <param name="dest">Target image.</param>
+/// <param name="offset">Offset of the mask inside the target.</param>
+/// <returns>The target with the patch cloned into it.</returns>
+cv::Mat MVCSolver::solve(ClonePlan const &plan, cv::Mat const &src, cv::Mat const &dest, glm::vec2 const &offset) const
+{
+	return solve(plan.components(), src, plan.mask(), {{dest, offset}}).front();
 }
 
 /// <summary>
-/// Main solver function. It first preprocess the mesh and mean-value coordinates
-/// Pre-computes the difference in intensities between boundary pixels of source and target patches
-//  Pre-computes the weighted sum using the mean value-coordinates as weights and the difference in intensity as value. 
-//  Lastly, iterates over all the pixels inside the masked patch, retrieves the triangle of the mesh that contains it, interpolates its value and computes final result
+/// Main solver function. Clones the masked region of the source into a single target.
 /// </summary>
 /// <param name="src">Source image.</param>
 /// <param name="dest">Target image.</param>
 /// <param name="mask">Masked region of the source that needs to be cloned over target.</param>
 /// <param name="offset">Position offset of the mask inside the target image space.</param>
 /// <returns>Final blended image.</returns>
-cv::Mat MVCSolver::solve(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset)
+cv::Mat MVCSolver::solve(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset) const
+{
+	return solve(src, mask, std::vector<CloneJob>{{dest, offset}}).front();
+}
+
+/// <summary>
+/// Clones the masked region of one source into many targets and/or offsets. It first preprocesses the mesh and mean-value
+/// coordinates (or loads them from the plan cache), once for all jobs.
+/// </summary>
+/// <param name="src">Source image.</param>
+/// <param name="mask">Masked region of the source that needs to be cloned over the targets.</param>
+/// <param name="jobs">Target images and the position offsets of the mask inside them.</param>
+/// <returns>Final blended images, one per job.</returns>
+std::vector<cv::Mat> MVCSolver::solve(cv::Mat const &src, cv::Mat const &mask, std::vector<CloneJob> const &jobs) const
+{
+	TRACE_SCOPE("solve");
+
+	// Build mesh and compute the mean-value coordinates of every mask component
+	auto const plans = this->plans(mask);
+	return solve(plans, src, mask, jobs);
+}
+
+/// <summary>
+/// Clones the masked region of the source into a tiled target, in place. Only the window of the target under the mask is
+/// read, solved and written back, so memory use and I/O grow with the size of the patch rather than of the target.
+/// Throws std::invalid_argument if the mask does not fit inside the store at the offset, see checkPlacement.
+/// </summary>
+/// <param name="src">Source image.</param>
+/// <param name="mask">Masked region of the source that needs to be cloned over the target.</param>
+/// <param name="dest">Target, of the type of the source.</param>
+/// <param name="offset">Position offset of the mask inside the target image space.</param>
+/// <returns>Number of tiles written.</returns>
+size_t MVCSolver::solve(cv::Mat const &src, cv::Mat const &mask, TileStore &dest, glm::vec2 const &offset) const
 {
+	TRACE_SCOPE("solve.tiled");
+	auto const ox = static_cast<int>(offset.x);
+	auto const oy = static_cast<int>(offset.y);
+
+	// The boundary lies on mask pixels, so the window under the bounding box of the mask holds every target pixel the
+	// solve reads; it must lie inside the store.
+	checkPlacement(src.size(), mask, dest.size(), offset);
+	auto const bbox = SpanMask(mask).bbox();
+	auto const window = cv::Rect(bbox.x + ox, bbox.y + oy, bbox.width, bbox.height);
+	if (window.empty())
+		return 0;
+
+	cv::Mat target;
+	{
+		TRACE_SCOPE("io.read");
+		target = dest.read(window);
+	}
+	auto const result = solve(plans(mask), src, mask, {{target, offset - glm::vec2(window.x, window.y)}}).front();
+
+	TRACE_SCOPE("io.write");
+	auto const written = dest.write(window.tl(), result);
+	Trace::count("tiles.written", static_cast<int64_t>(written));
+	return written;
+}
+
+/// <summary>
+/// Stores the difference in intensity between boundary pixels of target and source in consecutive rows (one per channel) of a matrix.
+/// </summary>
+/// <param name="boundary">Boundary rings.</param>
+/// <param name="src">Source image.</param>
+/// <param name="dest">Target image.</param>
+/// <param name="offset">Position offset of the mask inside the target image space.</param>
+/// <param name="diff">Matrix of boundary values.</param>
+/// <param name="row">First of the rows to fill.</param>
+template <typename Format>
+static void boundaryDifferences(Boundary const &boundary, cv::Mat const &src, cv::Mat const &dest, glm::vec2 const &offset, CoordinateMatrix &diff, size_t row)
+{
+	using Pixel = typename Format::pixel_type;
+	for (size_t i = 0; i < boundary.size(); ++i)
+	{
+		auto const &p = boundary[i];
+		auto const &a = dest.at<Pixel>(p.y() + offset.y, p.x() + offset.x);
+		auto const &b = src.at<Pixel>(p.y() , p.x());
+		for (int c = 0; c < Format::channels; ++c)
+			diff.row(row + c)[i] = static_cast<double>(a[c]) - static_cast<double>(b[c]);
+	}
+}
+
+/// <summary>
+/// Attaches the membrane values of one job to the corners of every triangle of the mesh.
+/// </summary>
+/// <param name="plan">Mesh of a mask component.</param>
+/// <param name="membrane">Membrane values of all jobs, V x (channels * J) row-major.</param>
+/// <param name="job">Index of the job.</param>
+/// <param name="jobs">Number of jobs J.</param>
+/// <param name="triangles">Triangles to append to.</param>
+template <typename Scalar, int Channels>
+static void membraneTriangles(MVCPlan const &plan, std::vector<double> const &membrane, int job, int jobs, RasterTriangles<cv::Vec<Scalar, Channels>> &triangles)
+{
+	auto const vertexValue = [&](int v)
+	{
+		auto const *m = membrane.data() + (static_cast<size_t>(v) * jobs + job) * Channels;
+		cv::Vec<Scalar, Channels> value;
+		for (int c = 0; c < Channels; ++c)
+			value[c] = static_cast<Scalar>(m[c]);
+		return value;
+	};
+	triangles.reserve(triangles.size() + plan.triangles.size());
+	for(auto const &t : plan.triangles)
+		triangles.push_back({{plan.vertices[t[0]], plan.vertices[t[1]], plan.vertices[t[2]]}, {vertexValue(t[0]), vertexValue(t[1]), vertexValue(t[2])}});
+}
+
+#ifndef NDEBUG
+/// <summary>
+/// Heap allocations made so far by the threads of an OpenMP team; allocations are counted per thread.
+/// </summary>
+static int64_t teamAllocations()
+{
+	int64_t total = 0;
+	#pragma omp parallel reduction(+:total)
+	total += static_cast<int64_t>(Trace::allocations());
+	return total;
+}
+#endif
+
+/// <summary>
+/// Scan-converts every triangle, interpolating the membrane inside it, and computes the final intensity of each covered pixel.
+/// Integer channels saturate; float channels (HDR) are written as they are. Nothing is allocated per pixel; debug builds
+/// of the executables count the allocations made by the threads of the pass as interpolate.allocations, which should stay at 0.
+/// </summary>
+/// <param name="triangles">Mesh triangles with the membrane values of their corners.</param>
+/// <param name="src">Source image.</param>
+/// <param name="region">Source pixels to write.</param>
+/// <param name="out">Output image; source pixel (x, y) lands on (x + shift.x, y + shift.y).</param>
+/// <param name="shift">Offset of the source inside the output.</param>
+template <typename Scalar, typename Format>
+static void blend(std::span<RasterTriangle<cv::Vec<Scalar, Format::channels>> const> triangles, cv::Mat const &src, SpanMask const &region, cv::Mat &out, cv::Point const &shift)
+{
+	using Pixel = typename Format::pixel_type;
+	using Channel = typename Format::channel_type;
+#ifndef NDEBUG
+	auto const allocations = teamAllocations();
+#endif
+	rasterize(triangles, region, [&](int x, int y, cv::Vec<Scalar, Format::channels> const &c)
+	{
+		auto const &srcI = src.at<Pixel>(y, x);
+		auto &resultI = out.at<Pixel>(y + shift.y, x + shift.x);
+		for (int k = 0; k < Format::channels; ++k)
+			resultI[k] = cv::saturate_cast<Channel>(static_cast<Scalar>(srcI[k]) + c[k]);
+	});
+#ifndef NDEBUG
+	Trace::count("interpolate.allocations", teamAllocations() - allocations);
+#endif
+}
+
+/// <summary>
+/// Clones the masked region of one source into many targets and/or offsets with plans built beforehand, e.g. once for
+/// every frame of a video. See solveAs.
+/// </summary>
+/// <param name="plans">Mesh and mean-value coordinates of every mask component.</param>
+/// <param name="src">Source image.</param>
+/// <param name="mask">Masked region of the source that needs to be cloned over the targets.</param>
+/// <param name="jobs">Target images and the position offsets of the mask inside them; they must have the type of the source.</param>
+/// <returns>Final blended images, one per job.</returns>
+std::vector<cv::Mat> MVCSolver::solve(std::vector<MVCPlan> const &plans, cv::Mat const &src, cv::Mat const &mask, std::vector<CloneJob> const &jobs) const
+{
+	for (auto const &job : jobs)
+		if (job.dest.type() != src.type())
+			throw std::invalid_argument("the source and the targets must have the same image type");
+
+	return visitPixelFormat(src.type(), [&](auto format)
+	{
+		using Format = decltype(format);
+		if (m_precision == Precision::Single)
+			return solveAs<float, Format>(plans, src, mask, jobs);
+		return solveAs<double, Format>(plans, src, mask, jobs);
+	});
+}
+
+/// <summary>
+/// Solve for one pixel format and precision.
+/// Pre-computes the difference in intensities between boundary pixels of source and target patches, for every job and component.
+//  Evaluates the membranes of all jobs together, as one product per component of the coordinate matrix with the stacked boundary differences.
+//  Lastly, rasterizes the meshes of all components once per job, interpolating its membrane over the pixels every triangle covers,
+//  and computes the results. Components are disjoint, so their triangles are scan-converted together in one parallel pass.
+//  The triangles of every job are built in one arena, so neither building them nor the per-pixel stage touches the heap.
+/// </summary>
+template <typename Scalar, typename Format>
+std::vector<cv::Mat> MVCSolver::solveAs(std::vector<MVCPlan> const &plans, cv::Mat const &src, cv::Mat const &mask, std::vector<CloneJob> const &jobs) const
+{
+	constexpr auto channels = Format::channels;
+	auto const J = static_cast<int>(jobs.size());
+
+	std::vector<std::vector<double>> membranes;
+	membranes.reserve(plans.size());
+	for (auto const &plan : plans)
+	{
+		// Compute and store the difference in intensity between boundary pixels of source and target patches,
+		// one row per channel of every job.
+		CoordinateMatrix intensityDiff(channels * jobs.size(), plan.boundary.size());
+		{
+			TRACE_SCOPE("differences");
+			#pragma omp parallel for schedule(static)
+			for (int j = 0; j < J; ++j)
+				boundaryDifferences<Format>(plan.boundary, src, jobs[j].dest, jobs[j].offset, intensityDiff, channels * j);
+		}
+
+		// Pre-compute the weighted sum of intensities and mean-value coordinates, all jobs and channels in one blocked product.
+		TRACE_SCOPE("membrane");
+		membranes.push_back(evaluateMembranes(plan, intensityDiff));
+	}
+
+	// The triangles of a job live in an arena sized for all components, which is reset between jobs.
+	size_t T = 0;
+	for (auto const &plan : plans)
+		T += plan.triangles.size();
+	SolveArena arena(T * sizeof(RasterTriangle<cv::Vec<Scalar, channels>>) + alignof(std::max_align_t));
+
+	auto const region = SpanMask(mask);
+	std::vector<cv::Mat> results;
+	results.reserve(J);
+	for (int j = 0; j < J; ++j)
+	{
+		auto const &[dest, offset] = jobs[j];
+		auto result = dest.clone();
+
+		arena.reset();
+		RasterTriangles<cv::Vec<Scalar, channels>> triangles(arena.resource());
+		triangles.reserve(T);
+		for (size_t c = 0; c < plans.size(); ++c)
+			membraneTriangles(plans[c], membranes[c], j, J, triangles);
+
+		// Only visit masked source pixels that land inside the target image.
+		auto const ox = static_cast<int>(offset.x);
+		auto const oy = static_cast<int>(offset.y);
+		auto const clipped = region.clip(cv::Rect(0, 0, src.cols, src.rows) & cv::Rect(-ox, -oy, dest.cols, dest.rows));
+
+		{
+			TRACE_SCOPE("interpolate");
+			blend<Scalar, Format>(triangles, src, clipped, result, {ox, oy});
+		}
+		Trace::count("pixels.written", static_cast<int64_t>(clipped.area()));
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+/// <summary>
+/// Clones the masked region of a source into a frame that already shows the target, writing only the pixels under the
+/// patch; e.g. to redraw a patch while it is dragged over the target. The mesh and coordinates of the plans are reused as
+/// they are: only the boundary differences at the new offset, the membrane and the interpolation are computed.
+/// </summary>
+/// <param name="plans">Mesh and mean-value coordinates of every mask component.</param>
+/// <param name="src">Source image.</param>
+/// <param name="region">Masked source pixels.</param>
+/// <param name="dest">Target image the boundary differences are taken from; the whole boundary must land inside it.</param>
+/// <param name="frame">Image of the size and type of the target to write to.</param>
+/// <param name="offset">Position offset of the mask inside the target image space.</param>
+/// <returns>Rectangle of the frame that was written, empty if the patch lies outside of it.</returns>
+cv::Rect MVCSolver::render(std::vector<MVCPlan> const &plans, cv::Mat const &src, SpanMask const &region, cv::Mat const &dest, cv::Mat &frame, cv::Point const &offset) const
+{
+	if (dest.type() != src.type() || frame.type() != dest.type() || frame.size() != dest.size())
+		throw std::invalid_argument("the source, the target and the frame must have the same image type");
+
+	TRACE_SCOPE("render");
+	return visitPixelFormat(src.type(), [&](auto format)
+	{
+		using Format = decltype(format);
+		if (m_precision == Precision::Single)
+			return renderAs<float, Format>(plans, src, region, dest, frame, offset);
+		return renderAs<double, Format>(plans, src, region, dest, frame, offset);
+	});
+}
+
+/// <summary>
+/// Render for one pixel format and precision.
+/// </summary>
+template <typename Scalar, typename Format>
+cv::Rect MVCSolver::renderAs(std::vector<MVCPlan> const &plans, cv::Mat const &src, SpanMask const &region, cv::Mat const &dest, cv::Mat &frame, cv::Point const &offset) const
+{
+	auto const clipped = region.clip(cv::Rect(0, 0, src.cols, src.rows) & cv::Rect(-offset.x, -offset.y, dest.cols, dest.rows));
+	if (clipped.empty())
+		return {};
+
+	RasterTriangles<cv::Vec<Scalar, Format::channels>> triangles;
+	for (auto const &plan : plans)
+	{
+		CoordinateMatrix intensityDiff(Format::channels, plan.boundary.size());
+		{
+			TRACE_SCOPE("differences");
+			boundaryDifferences<Format>(plan.boundary, src, dest, glm::vec2{offset.x, offset.y}, intensityDiff, 0);
+		}
+		TRACE_SCOPE("membrane");
+		membraneTriangles(plan, evaluateMembranes(plan, intensityDiff), 0, 1, triangles);
+	}
+
+	{
+		TRACE_SCOPE("interpolate");
+		blend<Scalar, Format>(triangles, src, clipped, frame, offset);
+	}
+	Trace::count("pixels.written", static_cast<int64_t>(clipped.area()));
+	return clipped.bbox() + offset;
+}
+
+/// <summary>
+/// Clones several independent patches into one target. Patches are solved concurrently, each against the original target
+/// and into a buffer covering only its own bounding box; the buffers are then composited into a single copy of the target
+/// in list order, so where patches overlap the later one is on top. Throws std::invalid_argument if a patch does not fit
+/// inside the target, see checkPlacement.
+/// </summary>
+/// <param name="dest">Target image.</param>
+/// <param name="patches">Source images, masks and the position offsets of the masks inside the target; sources must have the type of the target.</param>
+/// <returns>Final blended image.</returns>
+cv::Mat MVCSolver::composite(cv::Mat const &dest, std::vector<PatchJob> const &patches) const
+{
+	for (auto const &patch : patches)
+	{
+		if (patch.src.type() != dest.type())
+			throw std::invalid_argument("the sources and the target must have the same image type");
+		checkPlacement(patch.src.size(), patch.mask, dest.size(), patch.offset);
+	}
+
+	TRACE_SCOPE("composite");
+	return visitPixelFormat(dest.type(), [&](auto format)
+	{
+		using Format = decltype(format);
+		if (m_precision == Precision::Single)
+			return compositeAs<float, Format>(dest, patches);
+		return compositeAs<double, Format>(dest, patches);
+	});
+}
+
+/// <summary>
+/// Composite for one pixel format and precision.
+/// </summary>
+template <typename Scalar, typename Format>
+cv::Mat MVCSolver::compositeAs(cv::Mat const &dest, std::vector<PatchJob> const &patches) const
+{
+	using Pixel = typename Format::pixel_type;
+	auto const P = static_cast<int>(patches.size());
+	std::vector<SpanMask> regions(P);
+	std::vector<cv::Mat> tiles(P);
+
+	// Patches are distributed over the threads; the parallel loops inside a patch then run on the thread that owns it.
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int p = 0; p < P; ++p)
+	{
+		auto const &[src, mask, offset] = patches[p];
+		auto const ox = static_cast<int>(offset.x);
+		auto const oy = static_cast<int>(offset.y);
+		regions[p] = SpanMask(mask).clip(cv::Rect(0, 0, src.cols, src.rows) & cv::Rect(-ox, -oy, dest.cols, dest.rows));
+		if (regions[p].empty())
+			continue;
+
+		RasterTriangles<cv::Vec<Scalar, Format::channels>> triangles;
+		for (auto const &plan : this->plans(mask))
+		{
+			CoordinateMatrix intensityDiff(Format::channels, plan.boundary.size());
+			{
+				TRACE_SCOPE("differences");
+				boundaryDifferences<Format>(plan.boundary, src, dest, offset, intensityDiff, 0);
+			}
+			TRACE_SCOPE("membrane");
+			membraneTriangles(plan, evaluateMembranes(plan, intensityDiff), 0, 1, triangles);
+		}
+
+		// Masked pixels the mesh does not cover (its right and bottom edges, or outside a simplified boundary) keep the target.
+		auto const bbox = regions[p].bbox();
+		tiles[p] = dest(bbox + cv::Point(ox, oy)).clone();
+		{
+			TRACE_SCOPE("interpolate");
+			blend<Scalar, Format>(triangles, src, regions[p], tiles[p], {-bbox.x, -bbox.y});
+		}
+		Trace::count("pixels.written", static_cast<int64_t>(regions[p].area()));
+	}
+
 	auto result = dest.clone();
+	for (int p = 0; p < P; ++p)
+	{
+		if (regions[p].empty())
+			continue;
+		auto const bbox = regions[p].bbox();
+		auto const ox = static_cast<int>(patches[p].offset.x);
+		auto const oy = static_cast<int>(patches[p].offset.y);
+		regions[p].forEachSpan([&](int y, int begin, int end)
+		{
+			auto const *from = tiles[p].ptr<Pixel>(y - bbox.y) + begin - bbox.x;
+			std::copy(from, from + (end - begin), result.ptr<Pixel>(y + oy) + ox + begin);
+		});
+	}
 
-	// Build mesh and compute the mean-value coordinates
-	auto boundary = getBoundary(mask);
+	return result;
+}
 
-	std::chrono::steady_clock::time_point time_start, time_end;
-	time_start = std::chrono::steady_clock::now();
-	
-	auto MVC = preprocessing(mask, boundary);
-	// Compute and store the difference in intensity between boundary pixels of source and target patches.
-	std::vector<cv::Vec3d> intensityDiff;
-	// #pragma omp parallel for	
-	for(auto const &p : boundary)
-	{
-		cv::Vec3d a {dest.at<cv::Vec3b>(p.y() + offset.y, p.x() + offset.x)};
-		cv::Vec3d b {src.at<cv::Vec3b>(p.y() , p.x())};
-		// #pragma omp critical
-		intensityDiff.push_back(a - b);
-	}
-
-	// Pre-compute the weighted sum of intensities and mean-value coordinates.
-	std::unordered_map<Point_2, cv::Vec3d> r;
-	auto vs = m_mesh.vertices();
-	for(auto const &p : vs)
-	{	
-		auto lambda = MVC.at(p);
-		cv::Vec3d c = cv::Vec3d(0.0, 0.0, 0.0);
-		for (int i = 0; i < intensityDiff.size(); i++)
-			c += intensityDiff[i]*lambda[i];
-		
-		// #pragma omp critical
-		r.insert({p, c});
-	}
-	// For each pixel inside the target patch compute the right intensity.
-	// #pragma omp parallel for collapse(2)
-	for (int y = 0; y < dest.rows; ++y)
-	{
-		for(int x = 0; x < dest.cols; ++x)
+/// <summary>
+/// Coarsest pyramid level at which the source, the target and the mask all keep at least one pixel per side;
+/// below it cv::resize would be asked for an empty image.
+/// </summary>
+static int coarsestLevel(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask)
+{
+	auto const side = std::min({src.cols, src.rows, dest.cols, dest.rows, mask.cols, mask.rows});
+	return side > 0 ? static_cast<int>(std::bit_width(static_cast<unsigned>(side))) - 1 : 0;
+}
+
+/// <summary>
+/// Approximates the solve from a coarser level of an image pyramid: source, target and mask are downsampled by 2^level,
+/// the membrane is solved on the small images, and its mesh is scaled back up and interpolated over the full-resolution
+/// source. The membrane is smooth, so this upsampling loses little; the cost of the mesh, the coordinates and the membrane
+/// product shrinks with the boundary and the number of vertices, leaving the interpolation as the only full-size stage.
+/// Masked pixels outside the scaled mesh, a fringe of at most 2^level pixels along the boundary where the membrane
+/// is close to the target anyway, keep the target.
+/// </summary>
+/// <param name="src">Source image.</param>
+/// <param name="dest">Target image, of the type of the source.</param>
+/// <param name="mask">Masked region of the source that needs to be cloned over the target.</param>
+/// <param name="offset">Position offset of the mask inside the target image space.</param>
+/// <param name="level">Pyramid level; 0 is the full solve. Levels past the smallest image are clamped to it.</param>
+/// <returns>Blended image of the size of the target.</returns>
+cv::Mat MVCSolver::preview(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset, int level) const
+{
+	level = std::min(level, coarsestLevel(src, dest, mask));
+	if (level <= 0)
+		return solve(src, dest, mask, offset);
+	if (dest.type() != src.type())
+		throw std::invalid_argument("the source and the target must have the same image type");
+
+	TRACE_SCOPE("preview");
+	return visitPixelFormat(src.type(), [&](auto format)
+	{
+		using Format = decltype(format);
+		if (m_precision == Precision::Single)
+			return previewAs<float, Format>(src, dest, mask, offset, level);
+		return previewAs<double, Format>(src, dest, mask, offset, level);
+	});
+}
+
+/// <summary>
+/// Preview for one pixel format and precision.
+/// </summary>
+template <typename Scalar, typename Format>
+cv::Mat MVCSolver::previewAs(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset, int level) const
+{
+	auto const factor = 1 << level;
+	auto const scale = 1.0 / factor;
+	cv::Mat smallSrc, smallDest, smallMask;
+	{
+		TRACE_SCOPE("pyramid");
+		cv::resize(src, smallSrc, cv::Size(), scale, scale, cv::INTER_AREA);
+		cv::resize(dest, smallDest, cv::Size(), scale, scale, cv::INTER_AREA);
+		cv::resize(mask, smallMask, cv::Size(), scale, scale, cv::INTER_NEAREST);
+		// Rounding can push a boundary point one pixel past the small target.
+		cv::copyMakeBorder(smallDest, smallDest, 0, 1, 0, 1, cv::BORDER_REPLICATE);
+	}
+	auto const smallOffset = glm::vec2(std::round(offset.x * scale), std::round(offset.y * scale));
+
+	RasterTriangles<cv::Vec<Scalar, Format::channels>> triangles;
+	for (auto const &plan : plans(smallMask))
+	{
+		CoordinateMatrix intensityDiff(Format::channels, plan.boundary.size());
 		{
-			Point_2 p{x, y};
-			// Is point outside the ROI/Mask? Then skip
-			if (boundCheck(p, boundary) != CGAL::ON_BOUNDED_SIDE) continue;
-			// Retrieve triangle in which point p lies.
-			auto t = m_mesh.getFace(p);
-			auto barycentric = getBarycenterCoordinates(t, p);
-			// Calculate the value of the pixel by interpolating inside triangle using barycentric coordinates.
-			cv::Vec3d c = barycentric[0]*r.at(t[0]) + barycentric[1]*r.at(t[1]) + barycentric[2]*r.at(t[2]);
-			cv::Vec3d srcI {src.at<cv::Vec3b>(y, x)};
-			cv::Vec3d resultI = srcI + c;
-
-			// Compute final intensity value of pixel p inside target patch
-			result.at<cv::Vec3b>(y+offset.y, x+offset.x) = {cv::saturate_cast<uchar>(resultI.val[0]), cv::saturate_cast<uchar>(resultI.val[1]), cv::saturate_cast<uchar>(resultI.val[2])};
+			TRACE_SCOPE("differences");
+			boundaryDifferences<Format>(plan.boundary, smallSrc, smallDest, smallOffset, intensityDiff, 0);
 		}
+		TRACE_SCOPE("membrane");
+		membraneTriangles(plan, evaluateMembranes(plan, intensityDiff), 0, 1, triangles);
 	}
-	time_end = std::chrono::steady_clock::now();
-	std::cout << std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count() / 1e3f<< "ms" << "\n";
-	
+
+	// A small pixel averages a factor x factor block, so its centre lies in the middle of that block.
+	auto const centre = (factor - 1) / 2.0;
+	for (auto &t : triangles)
+		for (auto &v : t.v)
+			v = Point_2(v.x() * factor + centre, v.y() * factor + centre);
+
+	auto const ox = static_cast<int>(offset.x);
+	auto const oy = static_cast<int>(offset.y);
+	auto const clipped = SpanMask(mask).clip(cv::Rect(0, 0, src.cols, src.rows) & cv::Rect(-ox, -oy, dest.cols, dest.rows));
+	auto result = dest.clone();
+	{
+		TRACE_SCOPE("interpolate");
+		blend<Scalar, Format>(triangles, src, clipped, result, {ox, oy});
+	}
+	Trace::count("pixels.written", static_cast<int64_t>(clipped.area()));
 	return result;
-}
\ No newline at end of file
+}
+
+/// <summary>
+/// Solves from the coarsest pyramid level to the full resolution, handing every result to a callback as soon as it is
+/// ready. The coarsest level is solved before returning, so the caller has a usable result right away; the finer levels
+/// are solved on a background thread that owns a copy of the solver and shares the pixels of the images, which must not
+/// change until it finishes.
+/// </summary>
+/// <param name="src">Source image.</param>
+/// <param name="dest">Target image, of the type of the source.</param>
+/// <param name="mask">Masked region of the source that needs to be cloned over the target.</param>
+/// <param name="offset">Position offset of the mask inside the target image space.</param>
+/// <param name="levels">Coarsest pyramid level, e.g. 3 for an eighth of the resolution; clamped as in preview.</param>
+/// <param name="onLevel">Called with every level; for all but the coarsest one on the background thread.</param>
+/// <param name="refine">Whether to go on with the finer levels after the coarsest one.</param>
+/// <returns>The result of the finest level that is solved: the full solve if refining, else the coarsest preview.</returns>
+std::future<cv::Mat> MVCSolver::solveProgressive(cv::Mat const &src, cv::Mat const &dest, cv::Mat const &mask, glm::vec2 const &offset, int levels, LevelCallback const &onLevel, bool refine) const
+{
+	levels = std::min(levels, coarsestLevel(src, dest, mask));
+	auto coarsest = preview(src, dest, mask, offset, levels);
+	if (onLevel)
+		onLevel(levels, coarsest);
+
+	if (!refine || levels <= 0)
+	{
+		std::promise<cv::Mat> done;
+		done.set_value(coarsest);
+		return done.get_future();
+	}
+
+	return std::async(std::launch::async, [solver = *this, src, dest, mask, offset, levels, onLevel]()
+	{
+		cv::Mat result;
+		for (int level = levels - 1; level >= 0; --level)
+		{
+			result = solver.preview(src, dest, mask, offset, level);
+			if (onLevel)
+				onLevel(level, result);
+		}
+		return result;
+	});
+}
@@ -0,0 +1,72 @@
+#include "patch_placer.hpp"
+
+#include <opencv2/highgui.hpp>
+
+PatchPlacer::PatchPlacer(PlacementPreview &preview, std::string const &windowName)
+    : m_preview(preview), m_windowName(windowName), m_target(preview.offset())
+{
+}
+PatchPlacer::PatchPlacer(PlacementPreview &preview)
+    : m_preview(preview), m_target(preview.offset())
+{
+}
+
+void PatchPlacer::placeHandler(int event, int x, int y)
+{
+    switch (event)
+    {
+        case cv::EVENT_LBUTTONDOWN:
+            m_dragging = true;
+            m_grab = cv::Point(x, y) - m_preview.offset();
+            break;
+        case cv::EVENT_MOUSEMOVE:
+            if (m_dragging)
+                m_target = cv::Point(x, y) - m_grab;
+            break;
+        case cv::EVENT_LBUTTONUP:
+            m_dragging = false;
+            break;
+    }
+}
+
+/// <summary>
+/// Shows the target with the cloned patch and lets the user drag the patch around. Every frame moves the patch to the
+/// last cursor position, and the average time of a move is printed when the window closes.
+/// </summary>
+/// <returns>True if the placement was accepted with 's', false if it was cancelled with 'q'.</returns>
+bool PatchPlacer::place()
+{
+    cv::namedWindow(m_windowName);
+    cv::setMouseCallback(m_windowName, placeHandlerStatic, this);
+    cv::imshow(m_windowName, m_preview.frame());
+
+    size_t moves = 0;
+    double ms = 0.0;
+    auto accepted = false;
+    while (true)
+    {
+        auto const start = std::chrono::steady_clock::now();
+        if (!m_preview.moveTo(m_target).empty())
+        {
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            ++moves;
+            cv::imshow(m_windowName, m_preview.frame());
+        }
+
+        auto key = cv::waitKey(1) & 0xFF;
+        if (key == 's')
+        {
+            accepted = true;
+            break;
+        }else if (key == 'q')
+        {
+            break;
+        }
+    }
+
+    if (moves > 0)
+        std::cout << moves << " moves, " << ms / moves << "ms per move\n";
+    std::cout << "Offset " << m_preview.offset().x << " " << m_preview.offset().y << "\n";
+    cv::destroyWindow(m_windowName);
+    return accepted;
+}
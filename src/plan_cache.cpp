@@ -0,0 +1,261 @@
+#include "plan_cache.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+static constexpr char planMagic[8] = {'M', 'V', 'C', 'P', 'L', 'A', 'N', '\0'};
+
+/// <summary>
+/// Creates a cache rooted at the given directory. The directory is created if it does not exist.
+/// </summary>
+/// <param name="dir">Directory in which plan files are stored.</param>
+/// <param name="rebuild">If set, cached plans are ignored (and overwritten by the next store).</param>
+PlanCache::PlanCache(std::filesystem::path const &dir, bool rebuild)
+    : m_dir(dir), m_rebuild(rebuild)
+{
+    std::filesystem::create_directories(m_dir);
+}
+
+/// <summary>
+/// Hashes the boundary polygons, the sampling options and the mesher (64-bit FNV-1a).
+/// </summary>
+/// <param name="boundary">List of boundary vertices.</param>
+/// <param name="sampling">Sampling used for the mean-value coordinates.</param>
+/// <param name="mesher">Mesher that built the mesh.</param>
+/// <returns>Key under which the plan of this boundary is stored.</returns>
+uint64_t PlanCache::key(Boundary const &boundary, SamplingOptions const &sampling, MeshBackend mesher)
+{
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](auto v)
+    {
+        unsigned char bytes[sizeof(v)];
+        std::memcpy(bytes, &v, sizeof(v));
+        for (auto b : bytes)
+            h = (h ^ b) * 1099511628211ull;
+    };
+    mix(static_cast<uint32_t>(sampling.mode));
+    if (sampling.mode == Sampling::Hierarchical)
+        mix(sampling.epsilon);
+    mix(static_cast<uint32_t>(mesher));
+    for (auto const &p : boundary)
+    {
+        mix(p.x());
+        mix(p.y());
+    }
+    for (auto r : boundary.rings)
+        mix(static_cast<int32_t>(r));
+    return h;
+}
+
+/// <summary>
+/// Path of the plan file for a key.
+/// </summary>
+std::filesystem::path PlanCache::path(uint64_t key) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".mvcplan";
+    return m_dir / name.str();
+}
+
+/// <summary>
+/// Byte offsets of the sections of a plan file.
+/// </summary>
+struct PlanLayout
+{
+    size_t boundary, vertices, triangles, rings, rows, weights, indices, size;
+};
+
+static PlanLayout layout(PlanHeader const &h)
+{
+    auto const sparse = h.sampling == static_cast<uint32_t>(Sampling::Hierarchical);
+    auto const align = CoordinateMatrix::alignment;
+
+    PlanLayout l {};
+    l.boundary = sizeof(PlanHeader);
+    l.vertices = l.boundary + h.boundaryCount * 2 * sizeof(double);
+    l.triangles = l.vertices + h.vertexCount * 2 * sizeof(double);
+    l.rings = l.triangles + h.triangleCount * 3 * sizeof(int32_t);
+    auto const end = l.rings + (h.ringCount + 1) * sizeof(int32_t);
+    l.rows = (end + align - 1) / align * align;
+    l.weights = l.rows + (sparse ? (h.vertexCount + 1) * sizeof(int64_t) : 0);
+    l.indices = l.weights + h.weightCount * sizeof(double);
+    l.size = l.indices + (sparse ? h.weightCount * sizeof(int32_t) : 0);
+    return l;
+}
+
+/// <summary>
+/// Looks up the plan of a boundary. The file is memory mapped (copy-on-write), and dense coordinates keep pointing into the mapping,
+/// so only the pages that are actually read are loaded from disk.
+/// </summary>
+/// <param name="boundary">List of boundary vertices.</param>
+/// <param name="sampling">Sampling used for the mean-value coordinates.</param>
+/// <param name="mesher">Mesher that built the mesh.</param>
+/// <returns>The cached plan, or nothing if there is no valid plan for exactly this boundary, sampling and mesher.</returns>
+std::optional<MVCPlan> PlanCache::load(Boundary const &boundary, SamplingOptions const &sampling, MeshBackend mesher) const
+{
+    if (m_rebuild) return std::nullopt;
+
+    auto const k = key(boundary, sampling, mesher);
+    auto const file = path(k);
+    if (!std::filesystem::exists(file)) return std::nullopt;
+
+    auto map = std::make_shared<boost::iostreams::mapped_file>();
+    try
+    {
+        boost::iostreams::mapped_file_params params(file.string());
+        params.flags = boost::iostreams::mapped_file::priv;
+        map->open(params);
+    }
+    catch (std::exception const &e)
+    {
+        std::cerr << "Failed to map plan " << file << ": " << e.what() << "\n";
+        return std::nullopt;
+    }
+
+    // Validate header and size before touching the payload; anything unexpected is a cache miss.
+    if (map->size() < sizeof(PlanHeader)) return std::nullopt;
+    PlanHeader header;
+    std::memcpy(&header, map->const_data(), sizeof(PlanHeader));
+    if (std::memcmp(header.magic, planMagic, sizeof(planMagic)) != 0 || header.version != version || header.key != k)
+        return std::nullopt;
+    if (header.boundaryCount != boundary.size() || header.ringCount != static_cast<uint64_t>(boundary.ringCount())) return std::nullopt;
+    if (header.sampling != static_cast<uint32_t>(sampling.mode) || header.mesher != static_cast<uint32_t>(mesher)) return std::nullopt;
+    // The key only hashes epsilon; a plan sampled with another accuracy is rebuilt rather than trusted on a collision.
+    if (sampling.mode == Sampling::Hierarchical && header.epsilon != sampling.epsilon) return std::nullopt;
+
+    auto const sparse = sampling.mode == Sampling::Hierarchical;
+    auto const B = header.boundaryCount, V = header.vertexCount, T = header.triangleCount, W = header.weightCount;
+    if (!sparse && (header.stride != CoordinateMatrix::stride(B) || W != V * header.stride)) return std::nullopt;
+    auto const l = layout(header);
+    if (map->size() != l.size) return std::nullopt;
+
+    auto *base = map->data();
+    auto const *bs = reinterpret_cast<double const *>(base + l.boundary);
+    auto const *vs = reinterpret_cast<double const *>(base + l.vertices);
+    auto const *ts = reinterpret_cast<int32_t const *>(base + l.triangles);
+    auto const *rs = reinterpret_cast<int32_t const *>(base + l.rings);
+
+    // Guard against hash collisions.
+    for (size_t i = 0; i < B; ++i)
+        if (bs[2 * i] != boundary[i].x() || bs[2 * i + 1] != boundary[i].y()) return std::nullopt;
+    for (size_t r = 0; r < boundary.rings.size(); ++r)
+        if (rs[r] != boundary.rings[r]) return std::nullopt;
+
+    MVCPlan plan;
+    plan.boundary = boundary;
+    plan.mesher = mesher;
+    plan.sampling = sampling;
+    plan.vertices.reserve(V);
+    for (size_t i = 0; i < V; ++i)
+        plan.vertices.push_back(Point_2{vs[2 * i], vs[2 * i + 1]});
+    plan.triangles.resize(T);
+    for (size_t i = 0; i < T; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            auto const v = ts[3 * i + j];
+            if (v < 0 || static_cast<uint64_t>(v) >= V) return std::nullopt;
+            plan.triangles[i][j] = v;
+        }
+    }
+
+    if (!sparse)
+    {
+        // The matrix shares ownership of the mapping, which stays open as long as the plan is alive.
+        auto *weights = reinterpret_cast<double *>(base + l.weights);
+        plan.coordinates = CoordinateMatrix(V, B, std::shared_ptr<double>(map, weights));
+        return plan;
+    }
+
+    auto const *rows = reinterpret_cast<int64_t const *>(base + l.rows);
+    auto const *ws = reinterpret_cast<double const *>(base + l.weights);
+    auto const *is = reinterpret_cast<int32_t const *>(base + l.indices);
+    if (rows[0] != 0 || static_cast<uint64_t>(rows[V]) != W) return std::nullopt;
+    plan.sparseCoordinates.rows.assign(rows, rows + V + 1);
+    plan.sparseCoordinates.weights.reserve(W);
+    for (size_t i = 0; i < W; ++i)
+    {
+        if (is[i] < 0 || static_cast<uint64_t>(is[i]) >= B) return std::nullopt;
+        plan.sparseCoordinates.weights.push_back({is[i], ws[i]});
+    }
+    for (size_t i = 0; i < V; ++i)
+        if (rows[i] > rows[i + 1]) return std::nullopt;
+
+    return plan;
+}
+
+/// <summary>
+/// Writes a plan to the cache. The file is written under a temporary name and renamed, so concurrent readers never see a partial plan.
+/// </summary>
+/// <param name="plan">Plan to store.</param>
+void PlanCache::store(MVCPlan const &plan) const
+{
+    auto const k = key(plan.boundary, plan.sampling, plan.mesher);
+    auto const sparse = plan.sampling.mode == Sampling::Hierarchical;
+
+    PlanHeader header {};
+    std::memcpy(header.magic, planMagic, sizeof(planMagic));
+    header.version = version;
+    header.sampling = static_cast<uint32_t>(plan.sampling.mode);
+    header.mesher = static_cast<uint32_t>(plan.mesher);
+    header.key = k;
+    header.epsilon = plan.sampling.epsilon;
+    header.boundaryCount = plan.boundary.size();
+    header.vertexCount = plan.vertices.size();
+    header.triangleCount = plan.triangles.size();
+    header.stride = CoordinateMatrix::stride(plan.boundary.size());
+    header.ringCount = static_cast<uint64_t>(plan.boundary.ringCount());
+    header.weightCount = sparse ? plan.sparseCoordinates.weights.size() : header.vertexCount * header.stride;
+    auto const l = layout(header);
+
+    auto const file = path(k);
+    auto tmp = file;
+    tmp += ".tmp" + std::to_string(std::random_device{}());
+    // A partial temporary file is removed again, so failed stores do not accumulate in the cache directory.
+    std::error_code error;
+
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        auto write = [&out](auto const &v) { out.write(reinterpret_cast<char const *>(&v), sizeof(v)); };
+        auto writeArray = [&out](auto const *v, size_t n) { out.write(reinterpret_cast<char const *>(v), static_cast<std::streamsize>(n * sizeof(*v))); };
+
+        write(header);
+        for (auto const &p : plan.boundary) { write(p.x()); write(p.y()); }
+        for (auto const &p : plan.vertices) { write(p.x()); write(p.y()); }
+        for (auto const &t : plan.triangles)
+            for (auto v : t) write(static_cast<int32_t>(v));
+        for (auto r : plan.boundary.rings) write(static_cast<int32_t>(r));
+        std::vector<char> padding(l.rows - l.rings - plan.boundary.rings.size() * sizeof(int32_t), 0);
+        writeArray(padding.data(), padding.size());
+
+        if (sparse)
+        {
+            writeArray(plan.sparseCoordinates.rows.data(), plan.sparseCoordinates.rows.size());
+            for (auto const &bw : plan.sparseCoordinates.weights) write(bw.weight);
+            for (auto const &bw : plan.sparseCoordinates.weights) write(static_cast<int32_t>(bw.index));
+        }
+        else
+        {
+            for (size_t i = 0; i < plan.coordinates.rows(); ++i)
+                writeArray(plan.coordinates.row(i), plan.coordinates.stride());
+        }
+
+        // Closing flushes the last block, which can fail too.
+        out.close();
+        if (!out)
+        {
+            std::cerr << "Failed to write plan " << tmp << "\n";
+            std::filesystem::remove(tmp, error);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp, file, error);
+    if (error)
+    {
+        std::cerr << "Failed to store plan " << file << ": " << error.message() << "\n";
+        std::filesystem::remove(tmp, error);
+    }
+}
@@ -0,0 +1,230 @@
+#include "mesher.hpp"
+
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    struct Cell
+    {
+        int x, y, size;
+    };
+
+    /// <summary>
+    /// Even-odd inside test of the boundary on the scanlines halfway between pixel rows, which never pass through a boundary
+    /// point. Row r holds the sorted x coordinates at which the boundary crosses y = r + 0.5.
+    /// </summary>
+    class Scanlines
+    {
+        int m_y0 = 0;
+        std::vector<std::vector<double>> m_rows;
+
+        public:
+            Scanlines(Boundary const &boundary, int y0, int y1) : m_y0(y0), m_rows(std::max(y1 - y0, 0))
+            {
+                for (int i = 0; i < static_cast<int>(boundary.size()); ++i)
+                {
+                    auto const &a = boundary[i];
+                    auto const &b = boundary[boundary.next(i)];
+                    if (a.y() != b.y())
+                        m_rows[static_cast<int>(std::min(a.y(), b.y())) - m_y0].push_back(0.5 * (a.x() + b.x()));
+                }
+                for (auto &row : m_rows)
+                    std::sort(row.begin(), row.end());
+            }
+
+            // Whether (x, y + 0.5) lies inside the boundary.
+            bool inside(double x, int y) const
+            {
+                if (y < m_y0 || y - m_y0 >= static_cast<int>(m_rows.size()))
+                    return false;
+                auto const &row = m_rows[y - m_y0];
+                return (std::lower_bound(row.begin(), row.end(), x) - row.begin()) % 2 == 1;
+            }
+    };
+
+    /// <summary>
+    /// Even-odd inside test at any point, against every boundary edge.
+    /// </summary>
+    bool insideAnywhere(Boundary const &boundary, double x, double y)
+    {
+        auto inside = false;
+        for (int i = 0; i < static_cast<int>(boundary.size()); ++i)
+        {
+            auto const &a = boundary[i];
+            auto const &b = boundary[boundary.next(i)];
+            if ((a.y() < y) != (b.y() < y) && x < a.x() + (y - a.y()) * (b.x() - a.x()) / (b.y() - a.y()))
+                inside = !inside;
+        }
+        return inside;
+    }
+
+    // Vertices are kept at doubled coordinates, so that the centres of pixel cells are integers too.
+    int64_t vertexKey(double x, double y)
+    {
+        return (static_cast<int64_t>(std::lround(2.0 * x)) << 32) ^ static_cast<uint32_t>(std::lround(2.0 * y));
+    }
+
+    // A diagonal boundary edge through the pixel cell with top-left corner (x, y): 0 from (x, y) to (x + 1, y + 1), 1 from (x + 1, y) to (x, y + 1).
+    int64_t diagonalKey(int x, int y, int diagonal)
+    {
+        return ((static_cast<int64_t>(x) << 32) ^ static_cast<uint32_t>(y)) * 2 + diagonal;
+    }
+}
+
+/// <summary>
+/// Meshes the inside of a pixel contour with a graded quadtree.
+/// </summary>
+/// <param name="boundary">Boundary rings of one mask component, as extracted by getBoundaries.</param>
+/// <param name="vertices">Receives the mesh vertices.</param>
+/// <param name="triangles">Receives the triangles inside the boundary.</param>
+void QuadtreeMesher::mesh(Boundary const &boundary, std::vector<Point_2> &vertices, std::vector<std::array<int, 3>> &triangles) const
+{
+    TRACE_SCOPE("mesh");
+    vertices.clear();
+    triangles.clear();
+    if (boundary.empty())
+        return;
+
+    // The cell cuts below rely on boundary edges being sides or diagonals of pixel cells.
+    std::unordered_set<int64_t> diagonals;
+    for (int i = 0; i < static_cast<int>(boundary.size()); ++i)
+    {
+        auto const &a = boundary[i];
+        auto const &b = boundary[boundary.next(i)];
+        auto const dx = b.x() - a.x(), dy = b.y() - a.y();
+        if (a.x() != std::floor(a.x()) || a.y() != std::floor(a.y()) || std::abs(dx) > 1.0 || std::abs(dy) > 1.0)
+            throw std::invalid_argument("the quadtree mesher only meshes pixel contours, whose consecutive points are 8-neighbours");
+        if (dx != 0.0 && dy != 0.0)
+            diagonals.insert(diagonalKey(static_cast<int>(std::min(a.x(), b.x())), static_cast<int>(std::min(a.y(), b.y())), dx * dy > 0.0 ? 0 : 1));
+    }
+
+    auto const [xlo, xhi] = std::minmax_element(boundary.begin(), boundary.end(), [](auto const &a, auto const &b){ return a.x() < b.x(); });
+    auto const [ylo, yhi] = std::minmax_element(boundary.begin(), boundary.end(), [](auto const &a, auto const &b){ return a.y() < b.y(); });
+    auto const x0 = static_cast<int>(xlo->x()), y0 = static_cast<int>(ylo->y());
+    auto const extent = static_cast<int>(std::max(xhi->x() - x0, yhi->y() - y0));
+    auto root = 1;
+    while (root < extent)
+        root *= 2;
+    Scanlines const scanlines(boundary, y0, static_cast<int>(yhi->y()));
+
+    // Split the cells top-down. Every cell carries the boundary points within one cell size of it, so that a cell
+    // without any is either entirely inside or entirely outside, and its neighbours are at most twice as small.
+    std::vector<Cell> pixels, squares;
+    std::vector<int> all(boundary.size());
+    std::iota(all.begin(), all.end(), 0);
+    auto const split = [&](auto const &self, Cell const &cell, std::vector<int> const &near) -> void
+    {
+        auto const touched = std::any_of(near.begin(), near.end(), [&](int i)
+        {
+            auto const &p = boundary[i];
+            return p.x() >= cell.x && p.x() <= cell.x + cell.size && p.y() >= cell.y && p.y() <= cell.y + cell.size;
+        });
+        if (!touched && !scanlines.inside(cell.x + 0.5, cell.y))
+            return;
+        if (cell.size == 1)
+        {
+            pixels.push_back(cell);
+            return;
+        }
+        if (near.empty() && cell.size <= m_maxCell)
+        {
+            squares.push_back(cell);
+            return;
+        }
+
+        auto const h = cell.size / 2;
+        for (int j = 0; j < 2; ++j)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                Cell const child {cell.x + i * h, cell.y + j * h, h};
+                std::vector<int> childNear;
+                for (auto k : near)
+                {
+                    auto const &p = boundary[k];
+                    if (p.x() >= child.x - h && p.x() <= child.x + 2 * h && p.y() >= child.y - h && p.y() <= child.y + 2 * h)
+                        childNear.push_back(k);
+                }
+                self(self, child, childNear);
+            }
+        }
+    };
+    split(split, Cell{x0, y0, root}, all);
+
+    std::unordered_map<int64_t, int> index;
+    auto const vertex = [&](double x, double y)
+    {
+        auto const [it, added] = index.try_emplace(vertexKey(x, y), static_cast<int>(vertices.size()));
+        if (added)
+            vertices.push_back(Point_2{x, y});
+        return it->second;
+    };
+    auto const triangle = [&](bool inside, Point_2 const &a, Point_2 const &b, Point_2 const &c)
+    {
+        if (inside)
+            triangles.push_back({vertex(a.x(), a.y()), vertex(b.x(), b.y()), vertex(c.x(), c.y())});
+    };
+
+    // Pixel cells: two triangles along the boundary diagonal that runs through the cell, if any, or four around its centre
+    // where the boundary crosses itself inside it. Every piece is kept if a point inside it is inside the boundary.
+    for (auto const &[x, y, size] : pixels)
+    {
+        Point_2 const a {double(x), double(y)}, b {x + 1.0, double(y)}, c {x + 1.0, y + 1.0}, d {double(x), y + 1.0};
+        auto const main = diagonals.count(diagonalKey(x, y, 0)) > 0;
+        auto const anti = diagonals.count(diagonalKey(x, y, 1)) > 0;
+        if (main && anti)
+        {
+            Point_2 const e {x + 0.5, y + 0.5};
+            triangle(insideAnywhere(boundary, x + 0.5, y + 0.25), a, b, e);
+            triangle(scanlines.inside(x + 0.75, y), b, c, e);
+            triangle(insideAnywhere(boundary, x + 0.5, y + 0.75), c, d, e);
+            triangle(scanlines.inside(x + 0.25, y), d, a, e);
+        }
+        else if (anti)
+        {
+            triangle(scanlines.inside(x + 0.25, y), a, b, d);
+            triangle(scanlines.inside(x + 0.75, y), b, c, d);
+        }
+        else
+        {
+            triangle(scanlines.inside(x + 0.75, y), a, b, c);
+            triangle(scanlines.inside(x + 0.25, y), a, c, d);
+        }
+    }
+
+    // Larger cells, once all corners exist: two triangles, or a fan around the centre through the corners of smaller
+    // neighbours that lie on the sides.
+    for (auto const &[x, y, size] : squares)
+    {
+        vertex(x, y);
+        vertex(x + size, y);
+        vertex(x + size, y + size);
+        vertex(x, y + size);
+    }
+    for (auto const &[x, y, size] : squares)
+    {
+        std::vector<int> ring;
+        auto const visit = [&](int px, int py)
+        {
+            if (auto const it = index.find(vertexKey(px, py)); it != index.end())
+                ring.push_back(it->second);
+        };
+        for (int i = 0; i < size; ++i) visit(x + i, y);
+        for (int i = 0; i < size; ++i) visit(x + size, y + i);
+        for (int i = 0; i < size; ++i) visit(x + size - i, y + size);
+        for (int i = 0; i < size; ++i) visit(x, y + size - i);
+
+        if (ring.size() == 4)
+        {
+            triangles.push_back({ring[0], ring[1], ring[2]});
+            triangles.push_back({ring[0], ring[2], ring[3]});
+            continue;
+        }
+        auto const centre = vertex(x + size / 2, y + size / 2);
+        for (size_t i = 0; i < ring.size(); ++i)
+            triangles.push_back({ring[i], ring[(i + 1) % ring.size()], centre});
+    }
+}
@@ -0,0 +1,119 @@
+#include "span_mask.hpp"
+
+/// <summary>
+/// Builds the span representation of a mask image. Any pixel whose first channel is non-zero is inside the mask.
+/// </summary>
+/// <param name="mask">8-bit mask image with one or more channels.</param>
+SpanMask::SpanMask(cv::Mat const &mask)
+{
+    cv::Mat aux = mask;
+    if (mask.depth() != CV_8U)
+        mask.convertTo(aux, CV_8U);
+
+    auto const step = static_cast<int>(aux.elemSize());
+    std::vector<Span> spans;
+    for (int y = 0; y < aux.rows; ++y)
+    {
+        auto const *row = aux.ptr<uchar>(y);
+        int x = 0;
+        while (x < aux.cols)
+        {
+            // Skip background, then consume the run of foreground pixels.
+            while (x < aux.cols && row[x * step] == 0) ++x;
+            auto const begin = x;
+            while (x < aux.cols && row[x * step] != 0) ++x;
+            if (begin < x)
+                spans.push_back({y, begin, x});
+        }
+    }
+    build(std::move(spans));
+}
+
+/// <summary>
+/// Stores a list of spans sorted by row and computes the bounding box and per-row index.
+/// </summary>
+/// <param name="spans">Non-overlapping spans, sorted by row and then by column.</param>
+void SpanMask::build(std::vector<Span> &&spans)
+{
+    m_spans = std::move(spans);
+    m_rows.clear();
+    if (m_spans.empty())
+    {
+        m_bbox = cv::Rect();
+        return;
+    }
+
+    auto x0 = m_spans.front().begin, x1 = m_spans.front().end;
+    for (auto const &s : m_spans)
+    {
+        x0 = std::min(x0, s.begin);
+        x1 = std::max(x1, s.end);
+    }
+    auto const y0 = m_spans.front().y, y1 = m_spans.back().y + 1;
+    m_bbox = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+
+    // Prefix index: first span of every row, with one sentinel past the last row.
+    m_rows.assign(m_bbox.height + 1, 0);
+    for (auto const &s : m_spans)
+        m_rows[s.y - y0 + 1]++;
+    std::partial_sum(m_rows.begin(), m_rows.end(), m_rows.begin());
+}
+
+/// <summary>
+/// Number of pixels inside the mask.
+/// </summary>
+size_t SpanMask::area() const
+{
+    size_t n = 0;
+    for (auto const &s : m_spans)
+        n += static_cast<size_t>(s.end - s.begin);
+    return n;
+}
+
+/// <summary>
+/// Retrieves the spans of a single row.
+/// </summary>
+/// <param name="y">Row index in image coordinates.</param>
+/// <returns>The spans of row y, left to right. Empty if the row is outside the bounding box.</returns>
+std::span<Span const> SpanMask::row(int y) const
+{
+    if (y < m_bbox.y || y >= m_bbox.y + m_bbox.height) return {};
+
+    auto const i = y - m_bbox.y;
+    return std::span<Span const>(m_spans).subspan(m_rows[i], m_rows[i + 1] - m_rows[i]);
+}
+
+/// <summary>
+/// Checks whether a pixel lies inside the mask.
+/// </summary>
+bool SpanMask::contains(int x, int y) const
+{
+    auto const r = row(y);
+    auto const it = std::upper_bound(r.begin(), r.end(), x, [](int v, Span const &s) { return v < s.begin; });
+    return it != r.begin() && x < std::prev(it)->end;
+}
+
+/// <summary>
+/// Restricts the mask to a rectangle.
+/// </summary>
+/// <param name="rect">Rectangle in image coordinates.</param>
+/// <returns>A mask that only contains the pixels of this mask inside rect.</returns>
+SpanMask SpanMask::clip(cv::Rect const &rect) const
+{
+    std::vector<Span> spans;
+    auto const area = rect & m_bbox;
+    for (int y = area.y; y < area.y + area.height; ++y)
+    {
+        for (auto const &s : row(y))
+        {
+            auto const begin = std::max(s.begin, area.x);
+            auto const end = std::min(s.end, area.x + area.width);
+            if (begin < end)
+                spans.push_back({y, begin, end});
+        }
+    }
+
+    SpanMask clipped;
+    clipped.build(std::move(spans));
+    return clipped;
+}
@@ -0,0 +1,168 @@
+#include "tile_store.hpp"
+
+#include <cstring>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+static constexpr char tileMagic[8] = {'M', 'V', 'C', 'T', 'I', 'L', 'E', '\0'};
+
+static size_t alignUp(size_t n, size_t alignment)
+{
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+static size_t tileBytes(TileHeader const &h)
+{
+    return alignUp(h.tileSize * h.tileSize * CV_ELEM_SIZE(h.type), TileStore::tileAlignment);
+}
+
+static size_t tileCount(uint64_t pixels, uint64_t tileSize)
+{
+    return static_cast<size_t>((pixels + tileSize - 1) / tileSize);
+}
+
+/// <summary>
+/// Opens an existing tile store for reading and writing.
+/// </summary>
+/// <param name="path">Tile store file.</param>
+TileStore::TileStore(std::filesystem::path const &path)
+    : m_map(std::make_shared<boost::iostreams::mapped_file>())
+{
+    boost::iostreams::mapped_file_params params(path.string());
+    params.flags = boost::iostreams::mapped_file::readwrite;
+    m_map->open(params);
+
+    if (m_map->size() < sizeof(TileHeader))
+        throw std::runtime_error(path.string() + " is not a tile store");
+    std::memcpy(&m_header, m_map->const_data(), sizeof(TileHeader));
+    if (std::memcmp(m_header.magic, tileMagic, sizeof(tileMagic)) != 0 || m_header.version != version || m_header.tileSize == 0)
+        throw std::runtime_error(path.string() + " is not a tile store of version " + std::to_string(version));
+
+    m_tileBytes = tileBytes(m_header);
+    auto const first = alignUp(sizeof(TileHeader), tileAlignment);
+    if (m_map->size() < first + tileCount(m_header.width, m_header.tileSize) * tileCount(m_header.height, m_header.tileSize) * m_tileBytes)
+        throw std::runtime_error(path.string() + " is truncated");
+    m_tiles = m_map->data() + first;
+}
+
+/// <summary>
+/// Creates a tile store of the given size and type. The pixels are zero; the file is sparse where the file system allows it.
+/// </summary>
+/// <param name="path">Tile store file, overwritten if it exists.</param>
+/// <param name="size">Image size.</param>
+/// <param name="type">Pixel type, e.g. CV_8UC3.</param>
+/// <param name="tileSize">Width and height of the tiles in pixels.</param>
+TileStore TileStore::create(std::filesystem::path const &path, cv::Size size, int type, int tileSize)
+{
+    TileHeader header {};
+    std::memcpy(header.magic, tileMagic, sizeof(tileMagic));
+    header.version = version;
+    header.type = type;
+    header.width = static_cast<uint64_t>(size.width);
+    header.height = static_cast<uint64_t>(size.height);
+    header.tileSize = static_cast<uint64_t>(tileSize);
+
+    auto const bytes = alignUp(sizeof(TileHeader), tileAlignment) + tileCount(header.width, header.tileSize) * tileCount(header.height, header.tileSize) * tileBytes(header);
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("could not create " + path.string());
+        file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    }
+    std::filesystem::resize_file(path, bytes);
+    return TileStore(path);
+}
+
+/// <summary>
+/// Converts an image file into a tile store. The image is decoded once, with its bit depth; all later clones into the
+/// store only touch the tiles under their patch.
+/// </summary>
+/// <param name="image">Image file.</param>
+/// <param name="path">Tile store file, overwritten if it exists.</param>
+/// <param name="tileSize">Width and height of the tiles in pixels.</param>
+TileStore TileStore::import(std::filesystem::path const &image, std::filesystem::path const &path, int tileSize)
+{
+    auto const img = cv::imread(image.string(), cv::IMREAD_COLOR | cv::IMREAD_ANYDEPTH);
+    if (img.empty())
+        throw std::runtime_error("could not decode " + image.string());
+
+    auto store = create(path, img.size(), img.type(), tileSize);
+    store.write({0, 0}, img);
+    return store;
+}
+
+/// <summary>
+/// Tiles overlapping a rectangle, each clipped to the rectangle and to the image.
+/// </summary>
+std::vector<cv::Rect> TileStore::tiles(cv::Rect const &rect) const
+{
+    auto const r = rect & cv::Rect(0, 0, size().width, size().height);
+    std::vector<cv::Rect> parts;
+    if (r.width <= 0 || r.height <= 0)
+        return parts;
+
+    auto const t = tileSize();
+    for (int ty = r.y / t; ty <= (r.y + r.height - 1) / t; ++ty)
+        for (int tx = r.x / t; tx <= (r.x + r.width - 1) / t; ++tx)
+            parts.push_back(cv::Rect(tx * t, ty * t, t, t) & r);
+    return parts;
+}
+
+/// <summary>
+/// First pixel of the tile that contains a rectangle.
+/// </summary>
+char *TileStore::tile(cv::Rect const &part) const
+{
+    auto const t = tileSize();
+    auto const index = static_cast<size_t>(part.y / t) * tileCount(m_header.width, m_header.tileSize) + static_cast<size_t>(part.x / t);
+    return m_tiles + index * m_tileBytes;
+}
+
+/// <summary>
+/// Copies a window of the image out of the tiles it overlaps.
+/// </summary>
+/// <param name="rect">Window, inside the image.</param>
+/// <returns>The pixels of the window.</returns>
+cv::Mat TileStore::read(cv::Rect const &rect) const
+{
+    cv::Mat out(rect.size(), type());
+    auto const elem = static_cast<size_t>(CV_ELEM_SIZE(type()));
+    auto const t = tileSize();
+    auto const parts = tiles(rect);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < static_cast<int>(parts.size()); ++i)
+    {
+        auto const &part = parts[i];
+        auto const *from = tile(part);
+        for (int y = part.y; y < part.y + part.height; ++y)
+            std::memcpy(out.ptr(y - rect.y) + (part.x - rect.x) * elem, from + (static_cast<size_t>(y % t) * t + part.x % t) * elem, part.width * elem);
+    }
+    return out;
+}
+
+/// <summary>
+/// Copies an image into the tiles it overlaps. Tiles outside it are not touched.
+/// </summary>
+/// <param name="origin">Position of the image inside the store; parts outside the store are dropped.</param>
+/// <param name="img">Pixels to write, of the type of the store.</param>
+/// <returns>Number of tiles written.</returns>
+size_t TileStore::write(cv::Point const &origin, cv::Mat const &img)
+{
+    if (img.type() != type())
+        throw std::invalid_argument("the image does not have the pixel type of the tile store");
+
+    auto const elem = static_cast<size_t>(CV_ELEM_SIZE(type()));
+    auto const t = tileSize();
+    auto const parts = tiles(cv::Rect(origin.x, origin.y, img.cols, img.rows));
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < static_cast<int>(parts.size()); ++i)
+    {
+        auto const &part = parts[i];
+        auto *to = tile(part);
+        for (int y = part.y; y < part.y + part.height; ++y)
+            std::memcpy(to + (static_cast<size_t>(y % t) * t + part.x % t) * elem, img.ptr(y - origin.y) + (part.x - origin.x) * elem, part.width * elem);
+    }
+    return parts.size();
+}
@@ -0,0 +1,227 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    struct Event
+    {
+        char const *name;
+        int thread;
+        int64_t start, duration, cpu;
+    };
+
+    struct Sample
+    {
+        char const *name;
+        int64_t time, value;
+    };
+
+    // Everything recorded so far. Events are coarse (one per stage and call), so a single lock is enough.
+    struct Recording
+    {
+        std::mutex mutex;
+        int64_t enabledAt = 0;
+        std::vector<Event> events;
+        std::vector<Sample> samples;
+        std::map<std::string, int64_t> counters;
+    };
+
+    Recording &recording()
+    {
+        static Recording r;
+        return r;
+    }
+
+    auto const origin = std::chrono::steady_clock::now();
+
+    int threadIndex()
+    {
+        static std::atomic<int> next {0};
+        thread_local int const index = next++;
+        return index;
+    }
+
+    double ms(int64_t us)
+    {
+        return us / 1e3;
+    }
+}
+
+/// <summary>
+/// Starts recording. Probes hit before this call are not recorded.
+/// </summary>
+void Trace::enable()
+{
+    {
+        std::lock_guard lock(recording().mutex);
+        recording().enabledAt = now();
+    }
+    s_enabled.store(true, std::memory_order_release);
+}
+
+/// <summary>
+/// Microseconds since the start of the program.
+/// </summary>
+int64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+/// <summary>
+/// Records one timed event on the calling thread, see TraceScope.
+/// </summary>
+/// <param name="name">Stage name.</param>
+/// <param name="start">Start time in microseconds, see now().</param>
+/// <param name="duration">Wall time in microseconds.</param>
+/// <param name="cpu">Process CPU time in microseconds.</param>
+void Trace::record(char const *name, int64_t start, int64_t duration, int64_t cpu)
+{
+    auto const thread = threadIndex();
+    std::lock_guard lock(recording().mutex);
+    recording().events.push_back({name, thread, start, duration, cpu});
+}
+
+void Trace::addCount(char const *name, int64_t value)
+{
+    auto const time = now();
+    std::lock_guard lock(recording().mutex);
+    auto &total = recording().counters[name];
+    total += value;
+    recording().samples.push_back({name, time, total});
+}
+
+namespace
+{
+    thread_local size_t allocationCount = 0;
+}
+
+/// <summary>
+/// Counts one heap allocation of the calling thread. Called by the counting operator new of allocation_hook.cpp.
+/// </summary>
+void Trace::countAllocation()
+{
+    ++allocationCount;
+}
+
+/// <summary>
+/// Number of heap allocations made by the calling thread so far. Only programs linking allocation_hook.cpp (the debug
+/// builds of mvcc and mvcc_bench) count them; everywhere else this stays 0.
+/// </summary>
+size_t Trace::allocations()
+{
+    return allocationCount;
+}
+
+/// <summary>
+/// Peak resident set size of the process in bytes, or 0 where the platform does not report it.
+/// </summary>
+size_t Trace::peakRss()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    // Linux reports kilobytes.
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+/// <summary>
+/// Writes everything recorded so far.
+/// </summary>
+/// <param name="out">Output stream.</param>
+/// <param name="format">Summary: calls, total wall time, total CPU time and longest call of every stage, the final value
+/// of every counter and the peak resident memory. Chrome: every event and counter update on a timeline.</param>
+void Trace::write(std::ostream &out, TraceFormat format)
+{
+    auto const end = now();
+    auto const rss = peakRss();
+    std::lock_guard lock(recording().mutex);
+    auto const &r = recording();
+
+    if (format == TraceFormat::Chrome)
+    {
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        auto first = true;
+        auto const separator = [&first]{ auto const s = first ? "\n" : ",\n"; first = false; return s; };
+        for (auto const &e : r.events)
+            out << separator() << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+                << ", \"ts\": " << e.start << ", \"dur\": " << e.duration << ", \"args\": {\"cpu_ms\": " << ms(e.cpu) << "}}";
+        for (auto const &s : r.samples)
+            out << separator() << "{\"name\": \"" << s.name << "\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << s.time
+                << ", \"args\": {\"value\": " << s.value << "}}";
+        out << separator() << "{\"name\": \"peak_rss_mb\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << end
+            << ", \"args\": {\"value\": " << rss / (1 << 20) << "}}";
+        out << "\n]}\n";
+        return;
+    }
+
+    struct Totals
+    {
+        int64_t calls = 0, wall = 0, cpu = 0, longest = 0;
+    };
+    std::map<std::string, Totals> stages;
+    for (auto const &e : r.events)
+    {
+        auto &t = stages[e.name];
+        ++t.calls;
+        t.wall += e.duration;
+        t.cpu += e.cpu;
+        t.longest = std::max(t.longest, e.duration);
+    }
+
+    out << "{\n  \"wall_ms\": " << ms(end - r.enabledAt) << ",\n  \"peak_rss_mb\": " << rss / double(1 << 20) << ",\n  \"stages\": {";
+    auto first = true;
+    for (auto const &[name, t] : stages)
+    {
+        out << (first ? "\n" : ",\n") << "    \"" << name << "\": {\"calls\": " << t.calls << ", \"wall_ms\": " << ms(t.wall)
+            << ", \"cpu_ms\": " << ms(t.cpu) << ", \"max_ms\": " << ms(t.longest) << "}";
+        first = false;
+    }
+    out << "\n  },\n  \"counters\": {";
+    first = true;
+    for (auto const &[name, value] : r.counters)
+    {
+        out << (first ? "\n" : ",\n") << "    \"" << name << "\": " << value;
+        first = false;
+    }
+    out << "\n  }\n}\n";
+}
+
+/// <summary>
+/// Enables tracing until the object is destroyed.
+/// </summary>
+/// <param name="path">File the trace is written to.</param>
+/// <param name="format">Format of the file.</param>
+TraceFile::TraceFile(std::string const &path, TraceFormat format) : m_path(path), m_format(format)
+{
+    Trace::enable();
+}
+
+TraceFile::~TraceFile()
+{
+    std::ofstream file(m_path);
+    if (!file)
+    {
+        std::cerr << "Could not write the trace to " << m_path << "\n";
+        return;
+    }
+    Trace::write(file, m_format);
+}
@@ -0,0 +1,160 @@
+#include "video_pipeline.hpp"
+
+#include <atomic>
+#include <exception>
+#include <iomanip>
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+/// <summary>
+/// Runs the decode, solve and encode stages until the input has no more frames.
+/// If a stage throws, all stages stop and the exception is rethrown on the calling thread.
+/// A frame the mask does not fit at the offset throws std::invalid_argument, see MVCSolver::checkPlacement.
+/// </summary>
+/// <param name="src">Source image.</param>
+/// <param name="mask">Masked region of the source that is cloned into every frame.</param>
+/// <param name="offset">Position offset of the mask inside the frames.</param>
+/// <param name="input">Opened video or image sequence.</param>
+/// <param name="output">Opened writer with the frame size of the input.</param>
+/// <returns>Frame count, wall time and time spent by every stage.</returns>
+PipelineStats VideoCloner::run(cv::Mat const &src, cv::Mat const &mask, glm::vec2 const &offset, cv::VideoCapture &input, cv::VideoWriter &output)
+{
+    PipelineStats stats;
+    auto const start = Clock::now();
+
+    auto const plans = m_solver.plans(mask);
+    BoundedQueue<cv::Mat> decoded(m_queueDepth), solved(m_queueDepth);
+
+    // The first error of any stage stops all of them: closing both queues unblocks every stage, and the error is
+    // rethrown once the threads are joined.
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::atomic<bool> failed {false};
+    auto const fail = [&](std::exception_ptr e)
+    {
+        {
+            std::lock_guard lock(errorMutex);
+            if (!error)
+                error = e;
+        }
+        failed = true;
+        decoded.close();
+        solved.close();
+    };
+
+    std::thread decoder([&]
+    {
+        auto &time = stats.stages[0];
+        try
+        {
+            while (!failed)
+            {
+                cv::Mat frame;
+                auto const t0 = Clock::now();
+                {
+                    TRACE_SCOPE("io.decode");
+                    if (!input.read(frame))
+                        break;
+                }
+                auto const t1 = Clock::now();
+                decoded.push(std::move(frame));
+                auto const t2 = Clock::now();
+                time.busy += seconds(t0, t1);
+                time.waiting += seconds(t1, t2);
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+        decoded.close();
+    });
+
+    std::thread encoder;
+    try
+    {
+        encoder = std::thread([&]
+        {
+            auto &time = stats.stages[2];
+            try
+            {
+                while (!failed)
+                {
+                    auto const t0 = Clock::now();
+                    auto frame = solved.pop();
+                    auto const t1 = Clock::now();
+                    if (!frame)
+                        break;
+                    {
+                        TRACE_SCOPE("io.encode");
+                        output.write(*frame);
+                    }
+                    time.waiting += seconds(t0, t1);
+                    time.busy += seconds(t1, Clock::now());
+                }
+            }
+            catch (...)
+            {
+                fail(std::current_exception());
+            }
+        });
+
+        // The solve stage runs on the calling thread and parallelizes every frame with OpenMP. The placement is checked
+        // against the first frame, and again whenever the frame size changes (e.g. within an image sequence).
+        auto &time = stats.stages[1];
+        cv::Size checked;
+        while (!failed)
+        {
+            auto const t0 = Clock::now();
+            auto frame = decoded.pop();
+            auto const t1 = Clock::now();
+            if (!frame)
+                break;
+            if (frame->size() != checked)
+            {
+                MVCSolver::checkPlacement(src.size(), mask, frame->size(), offset);
+                checked = frame->size();
+            }
+            auto result = std::move(m_solver.solve(plans, src, mask, {{*frame, offset}}).front());
+            auto const t2 = Clock::now();
+            solved.push(std::move(result));
+            time.waiting += seconds(t0, t1) + seconds(t2, Clock::now());
+            time.busy += seconds(t1, t2);
+            ++stats.frames;
+        }
+    }
+    catch (...)
+    {
+        fail(std::current_exception());
+    }
+    solved.close();
+
+    decoder.join();
+    if (encoder.joinable())
+        encoder.join();
+    if (error)
+        std::rethrow_exception(error);
+    stats.seconds = seconds(start, Clock::now());
+    return stats;
+}
+
+/// <summary>
+/// Prints the throughput of the run and the occupancy (busy share of the wall time) of every stage.
+/// </summary>
+void PipelineStats::print(std::ostream &out) const
+{
+    static constexpr std::array<char const *, 3> names {"decode", "solve", "encode"};
+    out << frames << " frames in " << seconds << "s (" << fps() << " fps)\n";
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        auto const occupancy = seconds > 0.0 ? 100.0 * stages[i].busy / seconds : 0.0;
+        out << "  " << std::left << std::setw(8) << names[i] << std::right << std::fixed << std::setprecision(1)
+            << occupancy << "% busy, " << stages[i].busy << "s working, " << stages[i].waiting << "s waiting\n";
+        out << std::defaultfloat;
+    }
+}